@@ -0,0 +1,32 @@
+#include "DeviceNameHelperRK.h"
+
+SerialLogHandler logHandler;
+
+SYSTEM_THREAD(ENABLED);
+
+retained DeviceNameHelperData deviceNameHelperRetained;
+
+void setup() {
+    // This two lines are here so you can see the debug logs. You probably
+    // don't want them in your code.
+    waitFor(Serial.isConnected, 10000);
+    delay(2000);
+
+    // You must call this from setup!
+    DeviceNameHelperRetained::instance().setup(&deviceNameHelperRetained);
+
+    // Wait up to 60 seconds for the name. This returns immediately if the
+    // name was saved in retained memory.
+    DeviceNameHelper::WaitResult result = DeviceNameHelperRetained::instance().waitForName(60s);
+    if (result == DeviceNameHelper::WaitResult::SUCCESS) {
+        Log.info("name=%s", DeviceNameHelperRetained::instance().getName());
+    }
+    else {
+        Log.info("no name yet, reason=%d", (int) result);
+    }
+}
+
+void loop() {
+    // You must call this from loop!
+    DeviceNameHelperRetained::instance().loop();
+}
@@ -0,0 +1,37 @@
+#include "DeviceNameHelperGateway.h"
+
+SerialLogHandler logHandler;
+
+SYSTEM_THREAD(ENABLED);
+
+// Device IDs of the peripherals connected to this gateway. In a real application
+// these would typically be discovered over BLE or serial.
+const char *peripheralIds[] = {
+    "0123456789abcdef01234567",
+    "89abcdef0123456789abcdef"
+};
+
+void setup() {
+    // This two lines are here so you can see the debug logs. You probably
+    // don't want them in your code.
+    waitFor(Serial.isConnected, 10000);
+    delay(2000);
+
+    DeviceNameHelperGateway::instance()
+        .withCheckPeriod(24h)
+        .withNameCallback([](const char *deviceId, const char *name) {
+            Log.info("deviceId=%s name=%s", deviceId, name);
+        });
+
+    // You must call this from setup!
+    DeviceNameHelperGateway::instance().setup();
+
+    for(const char *deviceId : peripheralIds) {
+        DeviceNameHelperGateway::instance().addDevice(deviceId);
+    }
+}
+
+void loop() {
+    // You must call this from loop!
+    DeviceNameHelperGateway::instance().loop();
+}
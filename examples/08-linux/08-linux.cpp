@@ -0,0 +1,50 @@
+// Runs DeviceNameHelper natively on Linux. This example is not for Particle devices.
+//
+// Build from the top of the library:
+// g++ -std=c++17 -O2 -Isrc examples/08-linux/08-linux.cpp src/*.cpp -o devicename
+//
+// There is no Particle cloud connection here, so this example answers the name request
+// itself. In a real gateway, the publish handler would send the request by MQTT, a web
+// service, etc. and call Particle.receive() when the response arrives.
+
+#include "DeviceNameHelperRK.h"
+
+#include <stdio.h>
+
+static String pendingEvent;
+
+int main(int argc, char *argv[]) {
+    const char *path = (argc > 1) ? argv[1] : "/tmp/devicename";
+
+    Particle.withDeviceId("0123456789abcdef01234567")
+        .withPublishHandler([](const char *eventName, const char *eventData) {
+            // Queue the response, it's delivered from Particle.process() like a real transport
+            pendingEvent = eventName;
+            return true;
+        })
+        .withProcessHandler([]() {
+            if (pendingEvent == "particle/device/name") {
+                pendingEvent = "";
+                Particle.receive("particle/device/name", "linux-gateway");
+            }
+        });
+    Particle.setConnected(true);
+
+    unsigned long start = millis();
+    DeviceNameHelperFile::instance().setup(path);
+
+    DeviceNameHelper::WaitResult result = DeviceNameHelperFile::instance().waitForName(10s);
+    if (result == DeviceNameHelper::WaitResult::SUCCESS) {
+        printf("name=%s in %lu ms\n", DeviceNameHelperFile::instance().getName(), millis() - start);
+    }
+    else {
+        printf("no name, reason=%d\n", (int) result);
+    }
+
+    DeviceNameHelperStats stats = DeviceNameHelperFile::instance().getStats();
+    printf("requests=%lu responses=%lu bytesSent=%lu bytesReceived=%lu\n", 
+        (unsigned long) stats.requestCount, (unsigned long) stats.responseCount, 
+        (unsigned long) stats.bytesSent, (unsigned long) stats.bytesReceived);
+
+    return 0;
+}
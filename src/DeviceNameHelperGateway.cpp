@@ -0,0 +1,825 @@
+#include "DeviceNameHelperGateway.h"
+
+#if HAL_PLATFORM_FILESYSTEM
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <algorithm>
+
+#if DEVICENAMEHELPER_USE_MMAP
+#include <sys/mman.h>
+#endif
+
+//
+// DeviceNameHelperTable
+//
+
+DeviceNameHelperTable::~DeviceNameHelperTable() {
+    close();
+}
+
+bool DeviceNameHelperTable::open(const char *path) {
+    close();
+
+    fd = ::open(path, O_RDONLY);
+    if (fd == -1) {
+        return false;
+    }
+
+    // count and poolSize are checked against the file size first so the offsets
+    // can't overflow size_t on 32-bit devices
+    struct stat st;
+    if (!readAt(0, &header, sizeof(header)) || header.magic != FILE_MAGIC || fstat(fd, &st) != 0 ||
+        header.count > (size_t) st.st_size / (DEVICENAMEHELPER_DEVICE_ID_BYTES + sizeof(DeviceNameHelperTableRecord)) ||
+        header.poolSize > (size_t) st.st_size ||
+        (size_t) st.st_size != poolOffset(header.count) + header.poolSize) {
+        // Not a valid table file
+        close();
+        return false;
+    }
+    mapFile(st.st_size);
+    return true;
+}
+
+void DeviceNameHelperTable::close() {
+#if DEVICENAMEHELPER_USE_MMAP
+    if (map) {
+        munmap((void *)map, mapSize);
+    }
+#endif
+    map = NULL;
+    mapSize = 0;
+
+    if (fd != -1) {
+        ::close(fd);
+        fd = -1;
+    }
+    memset(&header, 0, sizeof(header));
+}
+
+bool DeviceNameHelperTable::find(const uint8_t *id, size_t &index) const {
+    size_t low = 0;
+    size_t high = header.count;
+
+    while(low < high) {
+        size_t mid = low + (high - low) / 2;
+
+        uint8_t midId[DEVICENAMEHELPER_DEVICE_ID_BYTES];
+        const uint8_t *midPtr;
+        if (map) {
+            // Compare in place, open() checked that the IDs are within the file
+            midPtr = map + idOffset(mid);
+        }
+        else {
+            if (!readId(mid, midId)) {
+                break;
+            }
+            midPtr = midId;
+        }
+        int cmp = memcmp(midPtr, id, DEVICENAMEHELPER_DEVICE_ID_BYTES);
+        if (cmp == 0) {
+            index = mid;
+            return true;
+        }
+        if (cmp < 0) {
+            low = mid + 1;
+        }
+        else {
+            high = mid;
+        }
+    }
+    index = low;
+    return false;
+}
+
+bool DeviceNameHelperTable::readId(size_t index, uint8_t *id) const {
+    return index < header.count && readAt(idOffset(index), id, DEVICENAMEHELPER_DEVICE_ID_BYTES);
+}
+
+bool DeviceNameHelperTable::readRecord(size_t index, DeviceNameHelperTableRecord &record) const {
+    return index < header.count && readAt(recordOffset(header.count, index), &record, sizeof(record));
+}
+
+bool DeviceNameHelperTable::readName(const DeviceNameHelperTableRecord &record, char *buf, size_t bufSize) const {
+    if (bufSize == 0) {
+        return false;
+    }
+    size_t len = std::min((size_t) record.nameLen, bufSize - 1);
+    if ((size_t) record.nameOffset + len > header.poolSize || !readAt(poolOffset(header.count) + record.nameOffset, buf, len)) {
+        buf[0] = 0;
+        return false;
+    }
+    buf[len] = 0;
+    return true;
+}
+
+bool DeviceNameHelperTable::readEntry(size_t index, DeviceNameHelperGatewayEntry &entry) const {
+    uint8_t id[DEVICENAMEHELPER_DEVICE_ID_BYTES];
+    DeviceNameHelperTableRecord record;
+
+    memset(&entry, 0, sizeof(entry));
+    if (!readId(index, id) || !readRecord(index, record)) {
+        return false;
+    }
+    formatDeviceId(id, entry.deviceId);
+    entry.lastCheck = record.lastCheck;
+    return readName(record, entry.name, sizeof(entry.name));
+}
+
+// [static]
+bool DeviceNameHelperTable::parseDeviceId(const char *hex, uint8_t *id) {
+    for(size_t ii = 0; ii < DEVICENAMEHELPER_DEVICE_ID_LEN; ii++) {
+        char c = hex[ii];
+        uint8_t nibble;
+        if (c >= '0' && c <= '9') {
+            nibble = c - '0';
+        }
+        else if (c >= 'a' && c <= 'f') {
+            nibble = c - 'a' + 10;
+        }
+        else if (c >= 'A' && c <= 'F') {
+            nibble = c - 'A' + 10;
+        }
+        else {
+            // Also handles the string being too short
+            return false;
+        }
+        if ((ii % 2) == 0) {
+            id[ii / 2] = nibble << 4;
+        }
+        else {
+            id[ii / 2] |= nibble;
+        }
+    }
+    return hex[DEVICENAMEHELPER_DEVICE_ID_LEN] == 0;
+}
+
+// [static]
+void DeviceNameHelperTable::formatDeviceId(const uint8_t *id, char *hex) {
+    static const char *hexDigits = "0123456789abcdef";
+
+    for(size_t ii = 0; ii < DEVICENAMEHELPER_DEVICE_ID_BYTES; ii++) {
+        *hex++ = hexDigits[id[ii] >> 4];
+        *hex++ = hexDigits[id[ii] & 0xf];
+    }
+    *hex = 0;
+}
+
+void DeviceNameHelperTable::mapFile(size_t size) {
+#if DEVICENAMEHELPER_USE_MMAP
+    if (size == 0) {
+        return;
+    }
+    void *addr = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (addr != MAP_FAILED) {
+        map = (const uint8_t *)addr;
+        mapSize = size;
+    }
+#else
+    (void) size;
+#endif
+}
+
+bool DeviceNameHelperTable::readAt(size_t offset, void *buf, size_t len) const {
+    if (map) {
+        if (offset + len > mapSize) {
+            return false;
+        }
+        memcpy(buf, map + offset, len);
+        return true;
+    }
+    if (fd == -1 || lseek(fd, offset, SEEK_SET) != (off_t) offset) {
+        return false;
+    }
+    return read(fd, buf, len) == (int) len;
+}
+
+//
+// DeviceNameHelperGateway
+//
+
+DeviceNameHelperGateway *DeviceNameHelperGateway::_instance = 0;
+
+// [static]
+DeviceNameHelperGateway &DeviceNameHelperGateway::instance() {
+    if (!_instance) {
+        _instance = new DeviceNameHelperGateway();
+    }
+    return *_instance;
+}
+
+DeviceNameHelperGateway::DeviceNameHelperGateway() {
+}
+
+DeviceNameHelperGateway::~DeviceNameHelperGateway() {
+    if (logFd != -1) {
+        close(logFd);
+    }
+}
+
+void DeviceNameHelperGateway::setup(const char *path) {
+    this->path = path;
+
+    table.open(path);
+    readLog();
+
+    if (!hasSystemEvents) {
+        System.on(cloud_status | time_changed, &DeviceNameHelperGateway::systemEventHandler);
+        hasSystemEvents = true;
+    }
+
+    // The events only report changes, so get the current state now
+    cloudConnected = Particle.connected();
+    timeValid = Time.isValid();
+
+    stateHandler = &DeviceNameHelperGateway::stateWaitConnected;
+}
+
+void DeviceNameHelperGateway::loop() {
+    // This is done even when not connected, so devices added while offline don't
+    // grow changes and the log without limit
+    if (needsCompact()) {
+        compact();
+    }
+
+    if (stateHandler) {
+        stateHandler(*this);
+    }
+}
+
+DeviceNameHelperGateway &DeviceNameHelperGateway::withEventName(const char *eventName, const char *responseEventName) {
+    this->eventName = eventName;
+    if (responseEventName) {
+        this->responseEventName = responseEventName;
+    }
+    else {
+        this->responseEventName = String("hook-response/") + eventName;
+    }
+    return *this;
+}
+
+bool DeviceNameHelperGateway::addDevice(const char *deviceId) {
+    uint8_t id[DEVICENAMEHELPER_DEVICE_ID_BYTES];
+    if (!DeviceNameHelperTable::parseDeviceId(deviceId, id)) {
+        return false;
+    }
+
+    DeviceNameHelperGatewayEntry entry;
+    DeviceNameHelperTable::formatDeviceId(id, entry.deviceId);
+    if (!getEntry(entry.deviceId, entry)) {
+        // New, or previously removed
+        entry.flags = 0;
+        entry.lastCheck = 0;
+        entry.name[0] = 0;
+        putEntry(entry);
+    }
+    return true;
+}
+
+void DeviceNameHelperGateway::removeDevice(const char *deviceId) {
+    uint8_t id[DEVICENAMEHELPER_DEVICE_ID_BYTES];
+    if (!DeviceNameHelperTable::parseDeviceId(deviceId, id)) {
+        return;
+    }
+
+    DeviceNameHelperGatewayEntry entry;
+    DeviceNameHelperTable::formatDeviceId(id, entry.deviceId);
+    if (getEntry(entry.deviceId, entry)) {
+        entry.flags |= FLAG_REMOVED;
+        putEntry(entry);
+    }
+}
+
+const char *DeviceNameHelperGateway::getName(const char *deviceId) const {
+    uint8_t id[DEVICENAMEHELPER_DEVICE_ID_BYTES];
+    DeviceNameHelperGatewayEntry entry;
+
+    nameBuf[0] = 0;
+    if (DeviceNameHelperTable::parseDeviceId(deviceId, id)) {
+        DeviceNameHelperTable::formatDeviceId(id, entry.deviceId);
+        if (getEntry(entry.deviceId, entry)) {
+            strcpy(nameBuf, entry.name);
+        }
+    }
+    return nameBuf;
+}
+
+size_t DeviceNameHelperGateway::getDeviceCount() const {
+    size_t count = table.getCount();
+
+    for(auto it = changes.begin(); it != changes.end(); it++) {
+        uint8_t id[DEVICENAMEHELPER_DEVICE_ID_BYTES];
+        size_t index;
+        DeviceNameHelperTable::parseDeviceId(it->deviceId, id);
+        bool inTable = table.find(id, index);
+
+        if ((it->flags & FLAG_REMOVED) != 0 && inTable) {
+            count--;
+        }
+        else if ((it->flags & FLAG_REMOVED) == 0 && !inTable) {
+            count++;
+        }
+    }
+    return count;
+}
+
+bool DeviceNameHelperGateway::getEntry(const char *deviceId, DeviceNameHelperGatewayEntry &entry) const {
+    size_t index = findChange(deviceId);
+    if (index < changes.size() && strcmp(changes[index].deviceId, deviceId) == 0) {
+        entry = changes[index];
+        return (entry.flags & FLAG_REMOVED) == 0;
+    }
+
+    uint8_t id[DEVICENAMEHELPER_DEVICE_ID_BYTES];
+    if (DeviceNameHelperTable::parseDeviceId(deviceId, id) && table.find(id, index)) {
+        return table.readEntry(index, entry);
+    }
+    return false;
+}
+
+void DeviceNameHelperGateway::putEntry(const DeviceNameHelperGatewayEntry &entry) {
+    updateChange(entry);
+    appendLog(entry);
+    nextScan = 0;
+}
+
+void DeviceNameHelperGateway::updateChange(const DeviceNameHelperGatewayEntry &entry) {
+    size_t index = findChange(entry.deviceId);
+    if (index < changes.size() && strcmp(changes[index].deviceId, entry.deviceId) == 0) {
+        changes[index] = entry;
+    }
+    else {
+        changes.insert(changes.begin() + index, entry);
+    }
+}
+
+size_t DeviceNameHelperGateway::findChange(const char *deviceId) const {
+    auto it = std::lower_bound(changes.begin(), changes.end(), deviceId, 
+        [](const DeviceNameHelperGatewayEntry &entry, const char *id) {
+            return strcmp(entry.deviceId, id) < 0;
+        });
+    return it - changes.begin();
+}
+
+void DeviceNameHelperGateway::forEachEntry(std::function<bool(const DeviceNameHelperGatewayEntry &)> fn) const {
+    // Merge the table and changes, which are both sorted by device ID. Lowercase hex
+    // and binary device IDs sort in the same order.
+    size_t tableIndex = 0;
+    auto changeIt = changes.begin();
+    DeviceNameHelperGatewayEntry entry;
+
+    while(tableIndex < table.getCount() || changeIt != changes.end()) {
+        int cmp;
+        if (tableIndex >= table.getCount()) {
+            cmp = 1;
+        }
+        else if (changeIt == changes.end()) {
+            cmp = -1;
+        }
+        else {
+            uint8_t id[DEVICENAMEHELPER_DEVICE_ID_BYTES];
+            char hex[DEVICENAMEHELPER_DEVICE_ID_LEN + 1];
+            if (!table.readId(tableIndex, id)) {
+                break;
+            }
+            DeviceNameHelperTable::formatDeviceId(id, hex);
+            cmp = strcmp(hex, changeIt->deviceId);
+        }
+
+        if (cmp < 0) {
+            // Only in the table
+            if (!table.readEntry(tableIndex++, entry)) {
+                break;
+            }
+            if (!fn(entry)) {
+                break;
+            }
+        }
+        else {
+            // In changes, which replaces the table entry if there is one
+            if (cmp == 0) {
+                tableIndex++;
+            }
+            const DeviceNameHelperGatewayEntry &change = *changeIt++;
+            if ((change.flags & FLAG_REMOVED) == 0 && !fn(change)) {
+                break;
+            }
+        }
+    }
+}
+
+bool DeviceNameHelperGateway::save() {
+    // Count the devices and names first so the header can be written at the start
+    DeviceNameHelperTableHeader header;
+    header.magic = DeviceNameHelperTable::FILE_MAGIC;
+    header.count = 0;
+    header.poolSize = 0;
+    forEachEntry([&header](const DeviceNameHelperGatewayEntry &entry) {
+        header.count++;
+        header.poolSize += strlen(entry.name);
+        return true;
+    });
+
+    String tempPath = path + ".tmp";
+    int fd = open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        return false;
+    }
+
+    // Write the device IDs, then the records, then the names, in separate passes. Each
+    // write is an append. On LittleFS, a write in the middle of a file rewrites the rest
+    // of the file, so jumping between the sections would make a large table O(N^2).
+    bool success = write(fd, &header, sizeof(header)) == (int) sizeof(header);
+    if (success) {
+        forEachEntry([&](const DeviceNameHelperGatewayEntry &entry) {
+            uint8_t id[DEVICENAMEHELPER_DEVICE_ID_BYTES];
+            DeviceNameHelperTable::parseDeviceId(entry.deviceId, id);
+            success = write(fd, id, sizeof(id)) == (int) sizeof(id);
+            return success;
+        });
+    }
+    if (success) {
+        uint32_t nameOffset = 0;
+        forEachEntry([&](const DeviceNameHelperGatewayEntry &entry) {
+            DeviceNameHelperTableRecord record;
+            memset(&record, 0, sizeof(record));
+            record.lastCheck = entry.lastCheck;
+            record.nameOffset = nameOffset;
+            record.nameLen = strlen(entry.name);
+            nameOffset += record.nameLen;
+
+            success = write(fd, &record, sizeof(record)) == (int) sizeof(record);
+            return success;
+        });
+    }
+    if (success) {
+        forEachEntry([&](const DeviceNameHelperGatewayEntry &entry) {
+            size_t nameLen = strlen(entry.name);
+            success = nameLen == 0 || write(fd, entry.name, nameLen) == (int) nameLen;
+            return success;
+        });
+    }
+    if (close(fd) != 0) {
+        // The file system commits the file on close
+        success = false;
+    }
+
+    if (success) {
+        // Replace the table with the new file. rename() replaces the old table atomically,
+        // so there's always a complete table file even if the device resets here.
+        table.close();
+        success = (rename(tempPath.c_str(), path.c_str()) == 0);
+    }
+
+    if (success) {
+        table.open(path.c_str());
+        changes.clear();
+    }
+    else {
+        // Keep the changes in RAM and try again next time
+        unlink(tempPath.c_str());
+        table.open(path.c_str());
+    }
+    return success;
+}
+
+bool DeviceNameHelperGateway::needsCompact() const {
+    if (compactFailedTime != 0 && millis() - compactFailedTime < RETRY_WAIT_MS) {
+        return false;
+    }
+    // Compacting rewrites the whole table, so allow more changes for a larger table
+    size_t compactChanges = table.getCount() / COMPACT_TABLE_DIVISOR;
+    if (compactChanges < COMPACT_CHANGES) {
+        compactChanges = COMPACT_CHANGES;
+    }
+    return logFailed || changes.size() >= compactChanges || logRecords >= COMPACT_LOG_RECORDS;
+}
+
+void DeviceNameHelperGateway::compact() {
+    if (save()) {
+        logFailed = !resetLog();
+        compactFailedTime = 0;
+    }
+    else {
+        compactFailedTime = millis();
+        if (compactFailedTime == 0) {
+            compactFailedTime = 1;
+        }
+    }
+}
+
+void DeviceNameHelperGateway::readLog() {
+    changes.clear();
+    logRecords = 0;
+    logFailed = false;
+
+    if (logFd != -1) {
+        close(logFd);
+    }
+    String logPath = path + ".log";
+    logFd = open(logPath.c_str(), O_RDWR | O_CREAT, 0644);
+    if (logFd == -1) {
+        logFailed = true;
+        return;
+    }
+
+    DeviceNameHelperGatewayLogHeader header;
+    if (read(logFd, &header, sizeof(header)) != (int) sizeof(header) || 
+        header.magic != LOG_MAGIC || header.entrySize != sizeof(DeviceNameHelperGatewayEntry)) {
+        // Empty, or not a valid log file
+        logFailed = !resetLog();
+        return;
+    }
+
+    // Read a few entries at a time, in order, so the file is read in one pass
+    DeviceNameHelperGatewayEntry entries[4];
+    size_t validEnd = sizeof(header);
+    bool done = false;
+    while(!done) {
+        int count = read(logFd, entries, sizeof(entries));
+        if (count <= 0) {
+            break;
+        }
+
+        for(size_t ii = 0; ii < (size_t)count / sizeof(DeviceNameHelperGatewayEntry); ii++) {
+            DeviceNameHelperGatewayEntry &entry = entries[ii];
+            uint8_t id[DEVICENAMEHELPER_DEVICE_ID_BYTES];
+
+            if (memchr(entry.name, 0, sizeof(entry.name)) == NULL || 
+                !DeviceNameHelperTable::parseDeviceId(entry.deviceId, id)) {
+                // Corrupted, ignore the rest of the log
+                done = true;
+                break;
+            }
+            // changes is sorted by the lowercase ID, so don't trust the case in the file
+            DeviceNameHelperTable::formatDeviceId(id, entry.deviceId);
+            updateChange(entry);
+            logRecords++;
+            validEnd += sizeof(DeviceNameHelperGatewayEntry);
+        }
+        if ((size_t)count < sizeof(entries)) {
+            break;
+        }
+    }
+
+    // Discard a partial or corrupted entry and everything after it, so the next append
+    // isn't followed by old entries that would be replayed after a reset
+    struct stat st;
+    if (fstat(logFd, &st) != 0 || 
+        ((size_t) st.st_size > validEnd && ftruncate(logFd, validEnd) != 0)) {
+        logFailed = true;
+        return;
+    }
+
+    // Append after the last valid entry
+    if (lseek(logFd, validEnd, SEEK_SET) != (off_t) validEnd) {
+        logFailed = true;
+    }
+}
+
+bool DeviceNameHelperGateway::resetLog() {
+    logRecords = 0;
+
+    if (logFd != -1) {
+        close(logFd);
+    }
+    String logPath = path + ".log";
+    logFd = open(logPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (logFd == -1) {
+        return false;
+    }
+
+    DeviceNameHelperGatewayLogHeader header;
+    header.magic = LOG_MAGIC;
+    header.entrySize = sizeof(DeviceNameHelperGatewayEntry);
+    header.reserved = 0;
+    return write(logFd, &header, sizeof(header)) == (int) sizeof(header) && fsync(logFd) == 0;
+}
+
+void DeviceNameHelperGateway::appendLog(const DeviceNameHelperGatewayEntry &entry) {
+    if (logFd == -1 || logFailed) {
+        logFailed = true;
+        return;
+    }
+    // The file system does not commit writes until fsync() or close(), so sync each 
+    // entry or it would be lost on reset
+    if (write(logFd, &entry, sizeof(entry)) != (int) sizeof(entry) || fsync(logFd) != 0) {
+        logFailed = true;
+        return;
+    }
+    logRecords++;
+}
+
+long DeviceNameHelperGateway::dueTime(const DeviceNameHelperGatewayEntry &entry) const {
+    if (entry.lastCheck == 0) {
+        // Never checked
+        return 0;
+    }
+    if (!entry.name[0]) {
+        // Checked but the response did not include the name
+        return entry.lastCheck + MISSING_RETRY_S;
+    }
+    if (checkPeriod.count() == 0) {
+        return LONG_MAX;
+    }
+    return entry.lastCheck + checkPeriod.count();
+}
+
+size_t DeviceNameHelperGateway::buildRequest() {
+    long now = Time.now();
+    if (now < nextScan) {
+        // Nothing is due yet
+        return 0;
+    }
+
+    size_t count = 0;
+    long nextDue = LONG_MAX;
+
+    requestData = "";
+    forEachEntry([&](const DeviceNameHelperGatewayEntry &entry) {
+        long due = dueTime(entry);
+        if (due > now) {
+            nextDue = std::min(nextDue, due);
+            return true;
+        }
+        if (count == MAX_BATCH) {
+            // More than will fit in this request, scan again for the next one
+            nextDue = 0;
+            return false;
+        }
+        if (count++) {
+            requestData += ",";
+        }
+        requestData += entry.deviceId;
+        return true;
+    });
+    nextScan = nextDue;
+
+    return count;
+}
+
+void DeviceNameHelperGateway::stateWaitConnected() {
+    if (!cloudConnected || !timeValid) {
+        return;
+    }
+
+    if (!hasSubscribed) {
+        Particle.subscribe(responseEventName.c_str(), &DeviceNameHelperGateway::subscriptionHandler, this);
+        hasSubscribed = true;
+    }
+
+    stateHandler = &DeviceNameHelperGateway::stateWaitRequest;
+    stateTime = millis();
+}
+
+void DeviceNameHelperGateway::stateWaitRequest() {
+    if (!cloudConnected) {
+        stateHandler = &DeviceNameHelperGateway::stateWaitConnected;
+        return;
+    }
+
+    // This also allows time for the subscription to complete after connecting, 
+    // and limits how often the table is scanned when there's nothing to do
+    if (millis() - stateTime < REQUEST_INTERVAL_MS) {
+        return;
+    }
+    stateTime = millis();
+
+    if (buildRequest() == 0) {
+        return;
+    }
+
+    gotResponse = false;
+    awaitingResponse = true;
+    if (!Particle.publish(eventName, requestData.c_str())) {
+        // There won't be a response, so don't wait for one. Request the same devices
+        // again after retrying.
+        awaitingResponse = false;
+        nextScan = 0;
+        stateHandler = &DeviceNameHelperGateway::stateWaitRetry;
+        stateTime = millis();
+        return;
+    }
+
+    stateHandler = &DeviceNameHelperGateway::stateWaitResponse;
+}
+
+void DeviceNameHelperGateway::stateWaitResponse() {
+    if (gotResponse) {
+        processResponse();
+
+        // Make the next request, if any, after REQUEST_INTERVAL_MS
+        stateHandler = &DeviceNameHelperGateway::stateWaitRequest;
+        stateTime = millis();
+        return;
+    }
+
+    if (!cloudConnected) {
+        // Make the request again after reconnecting. The devices in the request were not
+        // counted when nextScan was calculated, so scan again.
+        awaitingResponse = false;
+        nextScan = 0;
+        stateHandler = &DeviceNameHelperGateway::stateWaitConnected;
+        return;
+    }
+
+    if (millis() - stateTime >= RESPONSE_WAIT_MS) {
+        // Request the same devices again after retrying
+        awaitingResponse = false;
+        nextScan = 0;
+        stateHandler = &DeviceNameHelperGateway::stateWaitRetry;
+        stateTime = millis();
+        return;
+    }
+}
+
+void DeviceNameHelperGateway::stateWaitRetry() {
+    if (millis() - stateTime >= RETRY_WAIT_MS) {
+        stateHandler = &DeviceNameHelperGateway::stateWaitConnected;
+    }
+}
+
+void DeviceNameHelperGateway::processResponse() {
+    long now = Time.now();
+    DeviceNameHelperGatewayEntry entry;
+
+    // Every device in the request has now been checked, even if the response does not
+    // include it, so it's not requested again immediately
+    const char *cp = requestData.c_str();
+    while(strlen(cp) >= DEVICENAMEHELPER_DEVICE_ID_LEN) {
+        memcpy(entry.deviceId, cp, DEVICENAMEHELPER_DEVICE_ID_LEN);
+        entry.deviceId[DEVICENAMEHELPER_DEVICE_ID_LEN] = 0;
+
+        if (getEntry(entry.deviceId, entry)) {
+            // Only the check time changed, so it's kept in RAM and not logged. If the
+            // device resets before the next compact(), the device is checked again.
+            entry.lastCheck = now;
+            updateChange(entry);
+        }
+        cp += DEVICENAMEHELPER_DEVICE_ID_LEN;
+        if (*cp == ',') {
+            cp++;
+        }
+    }
+
+    // Response is deviceId=name,deviceId=name,...
+    cp = responseData.c_str();
+    while(*cp) {
+        const char *end = strchr(cp, ',');
+        if (!end) {
+            end = cp + strlen(cp);
+        }
+        const char *equals = (const char *) memchr(cp, '=', end - cp);
+        if (equals && (size_t)(equals - cp) == DEVICENAMEHELPER_DEVICE_ID_LEN) {
+            uint8_t id[DEVICENAMEHELPER_DEVICE_ID_BYTES];
+            char deviceId[DEVICENAMEHELPER_DEVICE_ID_LEN + 1];
+            memcpy(deviceId, cp, DEVICENAMEHELPER_DEVICE_ID_LEN);
+            deviceId[DEVICENAMEHELPER_DEVICE_ID_LEN] = 0;
+
+            if (DeviceNameHelperTable::parseDeviceId(deviceId, id)) {
+                DeviceNameHelperTable::formatDeviceId(id, deviceId);
+            }
+            if (getEntry(deviceId, entry)) {
+                char name[DEVICENAMEHELPER_MAX_NAME_LEN + 1];
+                size_t originalLength;
+                DeviceNameHelper::copyName(equals + 1, end - equals - 1, name, originalLength);
+
+                if (name[0]) {
+                    if (strcmp(entry.name, name) != 0) {
+                        strcpy(entry.name, name);
+                        putEntry(entry);
+                    }
+                    if (nameCallback) {
+                        nameCallback(entry.deviceId, entry.name);
+                    }
+                }
+            }
+        }
+        cp = *end ? end + 1 : end;
+    }
+    responseData = "";
+    nextScan = 0;
+}
+
+void DeviceNameHelperGateway::subscriptionHandler(const char *eventName, const char *eventData) {
+    if (!awaitingResponse) {
+        // Duplicate or late response
+        return;
+    }
+    awaitingResponse = false;
+
+    // The response is processed by stateWaitResponse so the file and callbacks
+    // are only used from the state machine
+    responseData = eventData ? eventData : "";
+    gotResponse = true;
+}
+
+// [static]
+void DeviceNameHelperGateway::systemEventHandler(system_event_t event, int param) {
+    if (_instance) {
+        DeviceNameHelper::updateSystemFlags(event, param, _instance->cloudConnected, _instance->timeValid);
+    }
+}
+
+#endif /* HAL_PLATFORM_FILESYSTEM */
@@ -0,0 +1,793 @@
+#ifndef __DEVICENAMEHELPERGATEWAY_H
+#define __DEVICENAMEHELPERGATEWAY_H
+
+// Github: https://github.com/rickkas7/DeviceNameHelperRK
+// License: MIT
+
+#include "DeviceNameHelperRK.h"
+
+#if HAL_PLATFORM_FILESYSTEM
+
+#ifndef DEVICENAMEHELPER_USE_MMAP
+#if DEVICENAMEHELPER_POSIX && defined(__has_include)
+#if __has_include(<sys/mman.h>)
+/**
+ * @brief Defined to 1 if DeviceNameHelperTable memory-maps the table file
+ *
+ * This is only available on host builds. Device OS does not support mmap, so the file
+ * is read with read() instead. Define it to 0 before including this file to always use read().
+ */
+#define DEVICENAMEHELPER_USE_MMAP 1
+#endif
+#endif
+#endif
+
+#ifndef DEVICENAMEHELPER_USE_MMAP
+#define DEVICENAMEHELPER_USE_MMAP 0
+#endif
+
+/**
+ * @brief Length of a Particle device ID in characters (24 hex digits)
+ */
+const size_t DEVICENAMEHELPER_DEVICE_ID_LEN = 24;
+
+/**
+ * @brief Length of a Particle device ID in bytes, as stored in DeviceNameHelperTable
+ */
+const size_t DEVICENAMEHELPER_DEVICE_ID_BYTES = DEVICENAMEHELPER_DEVICE_ID_LEN / 2;
+
+/**
+ * @brief One device, used for changes to the DeviceNameHelperGateway table that have not
+ * been saved yet, and when reading an entry from DeviceNameHelperTable
+ */
+struct DeviceNameHelperGatewayEntry { // 64 bytes
+    /**
+     * @brief Device ID, lowercase hex, null terminated
+     */
+    char        deviceId[DEVICENAMEHELPER_DEVICE_ID_LEN + 1];
+
+    /**
+     * @brief Flag bits, DeviceNameHelperGateway::FLAG_REMOVED
+     */
+    uint8_t     flags;
+
+    /**
+     * @brief Last time the name was checked from Time.now(), or 0 if it has never been checked
+     */
+    long        lastCheck;
+
+    /**
+     * @brief The device name, or an empty string if not known
+     */
+    char        name[DEVICENAMEHELPER_MAX_NAME_LEN + 1];
+};
+
+/**
+ * @brief Header at the start of the DeviceNameHelperTable file
+ *
+ * The file consists of:
+ *
+ * - This header
+ * - count device IDs, DEVICENAMEHELPER_DEVICE_ID_BYTES each, binary, sorted
+ * - count DeviceNameHelperTableRecord structures, in the same order as the device IDs
+ * - The string pool, poolSize bytes, containing the names without null terminators
+ *
+ * The device IDs are separate from the records so the binary search reads as little 
+ * as possible.
+ */
+struct DeviceNameHelperTableHeader { // 12 bytes
+    /**
+     * @brief Magic bytes, DeviceNameHelperTable::FILE_MAGIC
+     */
+    uint32_t    magic;
+
+    /**
+     * @brief Number of devices
+     */
+    uint32_t    count;
+
+    /**
+     * @brief Size of the string pool in bytes
+     */
+    uint32_t    poolSize;
+};
+
+/**
+ * @brief Per-device record in the DeviceNameHelperTable file
+ */
+struct DeviceNameHelperTableRecord { // 12 bytes
+    /**
+     * @brief Last time the name was checked from Time.now(), or 0 if it has never been checked
+     */
+    int32_t     lastCheck;
+
+    /**
+     * @brief Offset of the name in the string pool
+     */
+    uint32_t    nameOffset;
+
+    /**
+     * @brief Length of the name in bytes, 0 if not known
+     */
+    uint8_t     nameLen;
+
+    /**
+     * @brief Reserved for future use, currently 0.
+     */
+    uint8_t     reserved[3];
+};
+
+/**
+ * @brief Header at the start of the DeviceNameHelperGateway change log file
+ *
+ * The log is the path of the table file with ".log" appended. After the header it
+ * contains DeviceNameHelperGatewayEntry structures, appended in the order the changes 
+ * were made. A later entry for a device replaces an earlier one.
+ */
+struct DeviceNameHelperGatewayLogHeader { // 8 bytes
+    /**
+     * @brief Magic bytes, DeviceNameHelperGateway::LOG_MAGIC
+     */
+    uint32_t    magic;
+
+    /**
+     * @brief sizeof(DeviceNameHelperGatewayEntry), so a log from an incompatible version is discarded
+     */
+    uint16_t    entrySize;
+
+    /**
+     * @brief Reserved for future use, currently 0.
+     */
+    uint16_t    reserved;
+};
+
+/**
+ * @brief Reads a packed table of device IDs and names from a file on the flash file system
+ *
+ * Lookups are a binary search of the device IDs in the file, so only a few small reads are
+ * needed and the table is never loaded into RAM. See DeviceNameHelperTableHeader for the 
+ * file format. Used by DeviceNameHelperGateway.
+ *
+ * When DEVICENAMEHELPER_USE_MMAP is 1, the file is memory-mapped read-only when opened, 
+ * and the binary search compares the device IDs in place instead of reading each one. 
+ * If mmap fails, it falls back to read().
+ */
+class DeviceNameHelperTable {
+public:
+    /**
+     * @brief Magic bytes used to detect if the file is valid
+     */
+    static const uint32_t FILE_MAGIC = 0x7787a2f4;
+
+    /**
+     * @brief Constructor. Call open() to use the table.
+     */
+    DeviceNameHelperTable() {};
+
+    /**
+     * @brief Destructor. Closes the file.
+     */
+    virtual ~DeviceNameHelperTable();
+
+    /**
+     * @brief Opens a table file
+     *
+     * @param path Path to the file
+     *
+     * @return true if the file exists and is valid. If not, the table is empty.
+     */
+    bool open(const char *path);
+
+    /**
+     * @brief Closes the file. The table is then empty.
+     */
+    void close();
+
+    /**
+     * @brief Returns the number of devices in the table
+     */
+    size_t getCount() const { return header.count; };
+
+    /**
+     * @brief Returns true if the file is memory-mapped
+     */
+    bool isMapped() const { return map != NULL; };
+
+    /**
+     * @brief Finds a device ID in the table
+     *
+     * @param id Device ID in binary (DEVICENAMEHELPER_DEVICE_ID_BYTES bytes)
+     *
+     * @param index Filled in with the index of the device, or where it would be inserted
+     * if it's not in the table.
+     *
+     * @return true if the device is in the table
+     */
+    bool find(const uint8_t *id, size_t &index) const;
+
+    /**
+     * @brief Reads the binary device ID at index
+     */
+    bool readId(size_t index, uint8_t *id) const;
+
+    /**
+     * @brief Reads the record at index
+     */
+    bool readRecord(size_t index, DeviceNameHelperTableRecord &record) const;
+
+    /**
+     * @brief Reads the name for a record from the string pool
+     *
+     * @param record The record from readRecord()
+     *
+     * @param buf Buffer to store the null terminated name in
+     *
+     * @param bufSize Size of buf. The name is truncated if it doesn't fit.
+     */
+    bool readName(const DeviceNameHelperTableRecord &record, char *buf, size_t bufSize) const;
+
+    /**
+     * @brief Reads the device ID, record, and name at index
+     */
+    bool readEntry(size_t index, DeviceNameHelperGatewayEntry &entry) const;
+
+    /**
+     * @brief Converts a device ID from hex to binary
+     *
+     * @param hex Device ID, DEVICENAMEHELPER_DEVICE_ID_LEN hex characters, upper or lowercase
+     *
+     * @param id Filled in with DEVICENAMEHELPER_DEVICE_ID_BYTES bytes
+     *
+     * @return true if hex is a valid device ID
+     */
+    static bool parseDeviceId(const char *hex, uint8_t *id);
+
+    /**
+     * @brief Converts a device ID from binary to lowercase hex, null terminated
+     */
+    static void formatDeviceId(const uint8_t *id, char *hex);
+
+    /**
+     * @brief Offset in the file of the device ID at index
+     */
+    static size_t idOffset(size_t index) { return sizeof(DeviceNameHelperTableHeader) + index * DEVICENAMEHELPER_DEVICE_ID_BYTES; };
+
+    /**
+     * @brief Offset in the file of the record at index in a table with count devices
+     */
+    static size_t recordOffset(size_t count, size_t index) { return idOffset(count) + index * sizeof(DeviceNameHelperTableRecord); };
+
+    /**
+     * @brief Offset in the file of the string pool in a table with count devices
+     */
+    static size_t poolOffset(size_t count) { return recordOffset(count, count); };
+
+protected:
+    /**
+     * @brief This class is not copyable
+     */
+    DeviceNameHelperTable(const DeviceNameHelperTable&) = delete;
+
+    /**
+     * @brief This class is not copyable
+     */
+    DeviceNameHelperTable& operator=(const DeviceNameHelperTable&) = delete;
+
+    /**
+     * @brief Read len bytes at offset in the file
+     */
+    bool readAt(size_t offset, void *buf, size_t len) const;
+
+    /**
+     * @brief Memory-maps the file. If it fails, map is NULL and readAt() uses read().
+     *
+     * @param size Size of the file in bytes
+     */
+    void mapFile(size_t size);
+
+    /**
+     * @brief File descriptor, or -1 if not open
+     */
+    int fd = -1;
+
+    /**
+     * @brief Read-only mapping of the whole file, or NULL if not mapped
+     */
+    const uint8_t *map = NULL;
+
+    /**
+     * @brief Size of the mapping in bytes
+     */
+    size_t mapSize = 0;
+
+    /**
+     * @brief Header read from the file. count is 0 if not open.
+     */
+    DeviceNameHelperTableHeader header = {0, 0, 0};
+};
+
+/**
+ * @brief Resolves and saves the names of other devices, such as BLE or serial peripherals of a gateway
+ *
+ * The cloud "particle/device/name" event can only return the name of the device making
+ * the request, so this class uses an event that you handle with a webhook or your own
+ * server. The names are requested in batches by publishing the request event (default:
+ * "DeviceNameHelperGateway") with the event data being a comma-separated list of device IDs.
+ * The response is received from the response event (default: "hook-response/DeviceNameHelperGateway")
+ * as comma-separated deviceId=name pairs. It must be a single event, not more than 512 bytes.
+ *
+ * The table of devices is saved in a file on the flash file system so names are available 
+ * immediately after restart. It's stored in the packed format of DeviceNameHelperTable, and
+ * lookups are a binary search of the file, so a large table doesn't use much RAM. Changes 
+ * are kept in a small sorted list in RAM and appended to a log file, so each change is a 
+ * single small write. When enough changes have accumulated, they are merged into the 
+ * table and the log is cleared.
+ *
+ * Like DeviceNameHelper, this is a singleton. You must call setup() and loop().
+ */
+class DeviceNameHelperGateway {
+public:
+    /**
+     * @brief Bit in DeviceNameHelperGatewayEntry flags if the device has been removed
+     */
+    static const uint8_t FLAG_REMOVED = 0x01;
+
+    /**
+     * @brief Magic bytes used to detect if the log file is valid
+     */
+    static const uint32_t LOG_MAGIC = 0x7787a2f5;
+
+    /**
+     * @brief Get the singleton instance of this class, creating it if necessary.
+     *
+     * You cannot construct an instance of this class manually, as a global or on
+     * the stack. You must instead use instance().
+     */
+    static DeviceNameHelperGateway &instance();
+
+    /**
+     * @brief You must call setup() from global setup()!
+     *
+     * @param path The path to the file to store the table in. Default is "/usr/devicenames".
+     */
+    void setup(const char *path = "/usr/devicenames");
+
+    /**
+     * @brief You must call this from loop on every call to loop()
+     */
+    void loop();
+
+    /**
+     * @brief Sets how often to check the names again. Default is 0, never check again.
+     *
+     * @param checkPeriod How often to check. You can use chrono literals such as 24h.
+     *
+     * @return *this, so you can chain the withXXX() calls, fluent-style.
+     */
+    DeviceNameHelperGateway &withCheckPeriod(std::chrono::seconds checkPeriod) { this->checkPeriod = checkPeriod; return *this; };
+
+    /**
+     * @brief Sets the request event name. The default is "DeviceNameHelperGateway".
+     *
+     * @param eventName The event name. The string is not copied and must remain valid,
+     * such as a string literal.
+     *
+     * @param responseEventName The response event name. Default is "hook-response/" followed by
+     * the request event name.
+     *
+     * You must call this before setup().
+     *
+     * @return *this, so you can chain the withXXX() calls, fluent-style.
+     */
+    DeviceNameHelperGateway &withEventName(const char *eventName, const char *responseEventName = NULL);
+
+    /**
+     * @brief Adds a function to call when the name of a device is retrieved
+     *
+     * @param nameCallback The function to call. It can be a C++11 lambda.
+     *
+     * @return *this, so you can chain the withXXX() calls, fluent-style.
+     *
+     * The name callback function has the prototype:
+     *
+     * void callback(const char *deviceId, const char *name)
+     */
+    DeviceNameHelperGateway &withNameCallback(std::function<void(const char *, const char *)> nameCallback) { this->nameCallback = nameCallback; return *this; };
+
+    /**
+     * @brief Adds a device to the table, if it's not already there
+     *
+     * @param deviceId The device ID (24 hex characters)
+     *
+     * @return true if the device ID is valid, false if not
+     *
+     * The name is requested in the next batch. Call this from loop() (or setup() after
+     * calling setup()), not from other threads.
+     */
+    bool addDevice(const char *deviceId);
+
+    /**
+     * @brief Removes a device from the table
+     *
+     * @param deviceId The device ID (24 hex characters)
+     */
+    void removeDevice(const char *deviceId);
+
+    /**
+     * @brief Returns the name of a device
+     *
+     * @param deviceId The device ID (24 hex characters)
+     *
+     * @return The name, or an empty string if the device is not in the table or the name
+     * is not known yet. The pointer is only valid until the next call to getName().
+     *
+     * This is a binary search of the table, so it's O(log n).
+     */
+    const char *getName(const char *deviceId) const;
+
+    /**
+     * @brief Returns the number of devices in the table
+     */
+    size_t getDeviceCount() const;
+
+    /**
+     * @brief Maximum number of device IDs in one request event
+     *
+     * This is limited by the 512 byte webhook response: 8 * (24 + 1 + 31 + 1) = 456 bytes.
+     */
+    static const size_t MAX_BATCH = 8;
+
+protected:
+    /**
+     * @brief Constructor - You never instantiate this class directly.
+     *
+     * Instead, use DeviceNameHelperGateway::instance() to get the singleton instance,
+     * creating it if necessary.
+     */
+    DeviceNameHelperGateway();
+
+    /**
+     * @brief This class is a singleton and never deleted
+     */
+    virtual ~DeviceNameHelperGateway();
+
+    /**
+     * @brief This class is not copyable
+     */
+    DeviceNameHelperGateway(const DeviceNameHelperGateway&) = delete;
+
+    /**
+     * @brief This class is not copyable
+     */
+    DeviceNameHelperGateway& operator=(const DeviceNameHelperGateway&) = delete;
+
+    /**
+     * @brief Merges the changes into the table file and clears changes
+     *
+     * The new table is written to a temporary file which is then renamed, so the 
+     * table is not lost if the device resets while saving. The file is written from
+     * start to end, reading the table once for each section, so every write is an append.
+     *
+     * @return true if the table was saved
+     */
+    bool save();
+
+    /**
+     * @brief Returns true if the changes should be merged into the table by compact()
+     *
+     * If saving the table failed, it's not tried again for RETRY_WAIT_MS.
+     */
+    bool needsCompact() const;
+
+    /**
+     * @brief Saves the table with the changes merged in, then clears the log
+     *
+     * If the device resets after saving the table but before clearing the log, the log
+     * is replayed on top of the new table at startup, which has the same result.
+     */
+    void compact();
+
+    /**
+     * @brief Opens the log file and reads it into changes. Called from setup().
+     *
+     * The log is read sequentially from start to end. A partial entry at the end, from 
+     * a reset while appending, or a corrupted entry is truncated along with everything 
+     * after it.
+     */
+    void readLog();
+
+    /**
+     * @brief Clears the log file, leaving only the header
+     *
+     * @return true if the header was written
+     */
+    bool resetLog();
+
+    /**
+     * @brief Appends an entry to the log file and syncs it, so it's kept if the device resets
+     *
+     * If the append fails, logFailed is set so compact() saves the changes to the table.
+     */
+    void appendLog(const DeviceNameHelperGatewayEntry &entry);
+
+    /**
+     * @brief Gets an entry from changes or the table
+     *
+     * @param deviceId Device ID, lowercase hex
+     *
+     * @param entry Filled in with the entry
+     *
+     * @return true if the device is in the table and has not been removed
+     */
+    bool getEntry(const char *deviceId, DeviceNameHelperGatewayEntry &entry) const;
+
+    /**
+     * @brief Adds or replaces an entry in changes and appends it to the log
+     */
+    void putEntry(const DeviceNameHelperGatewayEntry &entry);
+
+    /**
+     * @brief Adds or replaces an entry in changes without logging it
+     */
+    void updateChange(const DeviceNameHelperGatewayEntry &entry);
+
+    /**
+     * @brief Find a device in changes
+     *
+     * @return The index of the entry with deviceId, or the index where it would be inserted
+     * if it's not there.
+     */
+    size_t findChange(const char *deviceId) const;
+
+    /**
+     * @brief Calls fn for each device in the table with changes applied, in device ID order
+     *
+     * @param fn Function to call. Return false to stop.
+     *
+     * This reads the whole table file sequentially.
+     */
+    void forEachEntry(std::function<bool(const DeviceNameHelperGatewayEntry &)> fn) const;
+
+    /**
+     * @brief Returns the time (Time.now()) that the entry should be checked
+     */
+    long dueTime(const DeviceNameHelperGatewayEntry &entry) const;
+
+    /**
+     * @brief Builds requestData from the entries that need to be checked
+     *
+     * @return The number of devices in the request
+     */
+    size_t buildRequest();
+
+    /**
+     * @brief Waits until the cloud is connected and the time is valid
+     *
+     * Next state:
+     * stateWaitRequest
+     */
+    void stateWaitConnected();
+
+    /**
+     * @brief Publishes a request for the devices that need to be checked
+     *
+     * Requests are at least REQUEST_INTERVAL_MS apart.
+     *
+     * Next state:
+     * stateWaitResponse if a request was made
+     * stateWaitRetry if the publish failed
+     */
+    void stateWaitRequest();
+
+    /**
+     * @brief Waits for the response event
+     *
+     * Next state:
+     * stateWaitRequest - response received, there may be more devices to check
+     * stateWaitRetry - timeout (RESPONSE_WAIT_MS)
+     * stateWaitConnected - the cloud disconnected
+     */
+    void stateWaitResponse();
+
+    /**
+     * @brief Waits RETRY_WAIT_MS and tries again
+     *
+     * Next state:
+     * stateWaitConnected
+     */
+    void stateWaitRetry();
+
+    /**
+     * @brief Subscription handler for the response event
+     *
+     * Like DeviceNameHelper::subscriptionHandler(), only the first response after the 
+     * request is used, and it's stored in responseData for stateWaitResponse.
+     */
+    void subscriptionHandler(const char *eventName, const char *eventData);
+
+    /**
+     * @brief Updates the devices from responseData. Called from stateWaitResponse.
+     *
+     * Every device in the request is marked as checked. Updates that only change lastCheck
+     * are kept in changes but not logged. Names are copied using DeviceNameHelper::copyName() 
+     * and the name callback is called for each name. New names are logged.
+     */
+    void processResponse();
+
+    /**
+     * @brief System event handler for cloud_status and time_changed events
+     *
+     * Uses DeviceNameHelper::updateSystemFlags() to update cloudConnected and timeValid.
+     */
+    static void systemEventHandler(system_event_t event, int param);
+
+    /**
+     * @brief Minimum time between requests (milliseconds)
+     */
+    static const unsigned long REQUEST_INTERVAL_MS = 1000;
+
+    /**
+     * @brief How long to wait for a response before timing out (milliseconds)
+     */
+    static const unsigned long RESPONSE_WAIT_MS = 15000;
+
+    /**
+     * @brief How long to wait to retry after a timeout (milliseconds)
+     */
+    static const unsigned long RETRY_WAIT_MS = 5 * 60 * 1000; // 5 minutes
+
+    /**
+     * @brief How long to wait to request a name again if the response did not include it (seconds)
+     */
+    static const long MISSING_RETRY_S = 60 * 60; // 1 hour
+
+    /**
+     * @brief Merge changes into the table when there are this many devices in changes
+     *
+     * This is the minimum. For larger tables, COMPACT_TABLE_DIVISOR is used instead.
+     */
+    static const size_t COMPACT_CHANGES = 32;
+
+    /**
+     * @brief Merge changes into the table when changes has 1/COMPACT_TABLE_DIVISOR of the devices in the table
+     *
+     * Each compact() rewrites the whole table, so this limits the rewrites to about 
+     * COMPACT_TABLE_DIVISOR per check period, no matter how many devices there are. Changes 
+     * can use up to 64 / COMPACT_TABLE_DIVISOR (4) bytes of RAM per device in the table.
+     */
+    static const size_t COMPACT_TABLE_DIVISOR = 16;
+
+    /**
+     * @brief Merge changes into the table when the log has this many entries
+     *
+     * The log can have more entries than changes because each device can be logged
+     * more than once. This limits the size of the log and the time to read it at startup.
+     */
+    static const size_t COMPACT_LOG_RECORDS = 256;
+
+    /**
+     * @brief Path to the data file. Default is "/usr/devicenames"
+     */
+    String path;
+
+    /**
+     * @brief The saved table
+     */
+    DeviceNameHelperTable table;
+
+    /**
+     * @brief File descriptor of the log file, or -1 if not open
+     */
+    int logFd = -1;
+
+    /**
+     * @brief Number of entries in the log file
+     */
+    size_t logRecords = 0;
+
+    /**
+     * @brief true if appending to the log failed, so changes are only in RAM
+     */
+    bool logFailed = false;
+
+    /**
+     * @brief millis() value when compact() failed to save the table, or 0 if it did not fail
+     */
+    unsigned long compactFailedTime = 0;
+
+    /**
+     * @brief Changes that have not been saved to the table yet, sorted by deviceId
+     */
+    std::vector<DeviceNameHelperGatewayEntry> changes;
+
+    /**
+     * @brief Buffer for the name returned by getName()
+     */
+    mutable char nameBuf[DEVICENAMEHELPER_MAX_NAME_LEN + 1];
+
+    /**
+     * @brief Time.now() value when buildRequest() needs to scan the table again
+     *
+     * Scanning reads the whole table, so it's only done when something is due.
+     */
+    long nextScan = 0;
+
+    /**
+     * @brief How often to fetch names again in seconds (0 = never check again)
+     */
+    std::chrono::seconds checkPeriod = 0s;
+
+    /**
+     * @brief Request event name
+     */
+    const char *eventName = "DeviceNameHelperGateway";
+
+    /**
+     * @brief Response event name
+     */
+    String responseEventName = "hook-response/DeviceNameHelperGateway";
+
+    /**
+     * @brief Optional function or C++11 lambda to call when a name is retrieved
+     */
+    std::function<void(const char *, const char *)> nameCallback = 0;
+
+    /**
+     * @brief Current state handler
+     */
+    std::function<void(DeviceNameHelperGateway&)> stateHandler = 0;
+
+    /**
+     * @brief Some states use this for timing. It's a value from millis() if used.
+     */
+    unsigned long stateTime = 0;
+
+    /**
+     * @brief Event data for the request in progress, comma-separated device IDs
+     */
+    String requestData;
+
+    /**
+     * @brief Response event data, saved by subscriptionHandler for processResponse()
+     */
+    String responseData;
+
+    /**
+     * @brief true if Particle.subscribe has been called
+     */
+    bool hasSubscribed = false;
+
+    /**
+     * @brief true if System.on() has been called to register systemEventHandler
+     */
+    bool hasSystemEvents = false;
+
+    /**
+     * @brief true if the cloud is connected, updated from the cloud_status system event
+     */
+    volatile bool cloudConnected = false;
+
+    /**
+     * @brief true if the time is valid, updated from the time_changed system event
+     */
+    volatile bool timeValid = false;
+
+    /**
+     * @brief true if a request has been published and the response has not been received yet
+     */
+    bool awaitingResponse = false;
+
+    /**
+     * @brief true if the response has been received and saved in responseData
+     */
+    bool gotResponse = false;
+
+    /**
+     * @brief Singleton instance pointer, set by instance().
+     */
+    static DeviceNameHelperGateway *_instance;
+};
+
+#endif /* HAL_PLATFORM_FILESYSTEM */
+
+#endif /* __DEVICENAMEHELPERGATEWAY_H */
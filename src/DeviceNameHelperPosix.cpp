@@ -0,0 +1,137 @@
+#include "DeviceNameHelperRK.h"
+
+#if DEVICENAMEHELPER_POSIX
+
+#include <time.h>
+
+#include <random>
+
+DeviceNameHelperPosixTime Time;
+DeviceNameHelperPosixSystem System;
+DeviceNameHelperPosixCloud Particle;
+
+unsigned long millis() {
+    if (Time.isSimulated()) {
+        return Time.getSimulatedMillis();
+    }
+
+    static struct timespec start = {0, 0};
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    if (start.tv_sec == 0 && start.tv_nsec == 0) {
+        start = ts;
+    }
+    return (unsigned long)(ts.tv_sec - start.tv_sec) * 1000 + (ts.tv_nsec - start.tv_nsec) / 1000000;
+}
+
+void delay(unsigned long ms) {
+    if (Time.isSimulated()) {
+        Time.advance(ms);
+        return;
+    }
+
+    struct timespec ts;
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (ms % 1000) * 1000000;
+    nanosleep(&ts, NULL);
+}
+
+uint32_t HAL_RNG_GetRandomNumber() {
+    static std::random_device rd;
+    return (uint32_t) rd();
+}
+
+//
+// DeviceNameHelperPosixTime
+//
+
+time_t DeviceNameHelperPosixTime::now() const {
+    if (simulated) {
+        return simulatedStart + (time_t)(simulatedMillis / 1000);
+    }
+    return time(NULL);
+}
+
+bool DeviceNameHelperPosixTime::isValid() const {
+    return now() >= VALID_TIME;
+}
+
+//
+// DeviceNameHelperPosixSystem
+//
+
+bool DeviceNameHelperPosixSystem::on(system_event_t events, void (*handler)(system_event_t event, int param)) {
+    handlers.push_back(Handler{events, handler});
+    return true;
+}
+
+String DeviceNameHelperPosixSystem::deviceID() const {
+    if (deviceId.length() == 0) {
+        char hostname[64];
+        if (gethostname(hostname, sizeof(hostname)) == 0) {
+            hostname[sizeof(hostname) - 1] = 0;
+            return String(hostname);
+        }
+    }
+    return deviceId;
+}
+
+void DeviceNameHelperPosixSystem::notify(system_event_t event, int param) {
+    for(auto it = handlers.begin(); it != handlers.end(); it++) {
+        if ((it->events & event) != 0) {
+            it->handler(event, param);
+        }
+    }
+}
+
+//
+// DeviceNameHelperPosixCloud
+//
+
+void DeviceNameHelperPosixCloud::setConnected(bool connected) {
+    if (connected != isConnected) {
+        isConnected = connected;
+        System.notify(cloud_status, connected ? cloud_status_connected : cloud_status_disconnected);
+    }
+}
+
+void DeviceNameHelperPosixCloud::receive(const char *eventName, const char *eventData) {
+    // Use an index because a handler can subscribe, which can reallocate the vector
+    for(size_t ii = 0; ii < subscriptions.size(); ii++) {
+        const String &prefix = subscriptions[ii].prefix;
+        if (strncmp(eventName, prefix.c_str(), prefix.length()) == 0) {
+            // Copy the handler so it stays valid even if the vector is reallocated
+            auto handler = subscriptions[ii].handler;
+            handler(eventName, eventData ? eventData : "");
+        }
+    }
+}
+
+bool DeviceNameHelperPosixCloud::publish(const char *eventName, const char *eventData) {
+    if (!isConnected || !publishHandler) {
+        return false;
+    }
+    return publishHandler(eventName, eventData ? eventData : "");
+}
+
+bool DeviceNameHelperPosixCloud::subscribe(const char *prefix, void (*handler)(const char *eventName, const char *eventData)) {
+    subscriptions.push_back(Subscription{prefix, handler});
+    return true;
+}
+
+void DeviceNameHelperPosixCloud::process() {
+    if (processHandler) {
+        processHandler();
+    }
+
+    // Device OS generates time_changed when the time is synchronized. There's no notification
+    // when the system clock is set, so check for it here.
+    bool timeValid = Time.isValid();
+    if (timeValid && !timeWasValid) {
+        System.notify(time_changed, time_changed_sync);
+    }
+    timeWasValid = timeValid;
+}
+
+#endif /* DEVICENAMEHELPER_POSIX */
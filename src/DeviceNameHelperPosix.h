@@ -0,0 +1,325 @@
+#ifndef __DEVICENAMEHELPERPOSIX_H
+#define __DEVICENAMEHELPERPOSIX_H
+
+// Github: https://github.com/rickkas7/DeviceNameHelperRK
+// License: MIT
+
+// POSIX implementation of the parts of the Device OS API used by this library, so
+// the same code runs natively on Linux. This file is included from DeviceNameHelperRK.h
+// when DEVICENAMEHELPER_POSIX is 1; don't include it directly. It is not a general
+// replacement for Particle.h, only the subset that this library uses.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+/**
+ * @brief The POSIX file API is always available
+ */
+#define HAL_PLATFORM_FILESYSTEM 1
+
+/**
+ * @brief Milliseconds since startup, from the monotonic clock
+ */
+unsigned long millis();
+
+/**
+ * @brief Sleeps for ms milliseconds, or advances the simulated clock if it's enabled
+ */
+void delay(unsigned long ms);
+
+/**
+ * @brief Returns a random number from std::random_device, like the Device OS hardware RNG
+ */
+uint32_t HAL_RNG_GetRandomNumber();
+
+/**
+ * @brief Minimal version of the Device OS String class
+ */
+class String {
+public:
+    String() {};
+    String(const char *s) : s(s ? s : "") {};
+
+    const char *c_str() const { return s.c_str(); };
+    operator const char *() const { return c_str(); };
+    size_t length() const { return s.length(); };
+
+    String &operator=(const char *other) { s = other ? other : ""; return *this; };
+    String &operator+=(const char *other) { s += other ? other : ""; return *this; };
+    String operator+(const char *other) const { String result(*this); result += other; return result; };
+    bool operator==(const char *other) const { return s == (other ? other : ""); };
+
+protected:
+    std::string s;
+};
+
+/**
+ * @brief System event type for System.on()
+ */
+typedef uint64_t system_event_t;
+
+/**
+ * @brief Cloud connection changed. The param is one of the cloud_status_xxx values.
+ */
+const system_event_t cloud_status = 1 << 1;
+
+/**
+ * @brief The time was set
+ */
+const system_event_t time_changed = 1 << 2;
+
+enum {
+    cloud_status_disconnected,
+    cloud_status_connecting,
+    cloud_status_connected,
+    cloud_status_disconnecting
+};
+
+enum {
+    time_changed_manually,
+    time_changed_sync
+};
+
+/**
+ * @brief Replaces Time. Uses the system clock, or a simulated clock for tests and the simulator.
+ */
+class DeviceNameHelperPosixTime {
+public:
+    /**
+     * @brief Returns the Unix time in seconds
+     */
+    time_t now() const;
+
+    /**
+     * @brief Use a simulated clock instead of the system clock
+     * 
+     * @param start The Unix time to start at. millis() starts at 0.
+     * 
+     * @return *this, so you can chain the withXXX() calls, fluent-style.
+     * 
+     * The simulated clock only moves when advance() or delay() is called, so tests are
+     * repeatable and can run hours of simulated time in seconds.
+     */
+    DeviceNameHelperPosixTime &withSimulatedClock(time_t start = VALID_TIME) { simulated = true; simulatedStart = start; simulatedMillis = 0; return *this; };
+
+    /**
+     * @brief Advances the simulated clock by ms milliseconds
+     */
+    void advance(unsigned long ms) { simulatedMillis += ms; };
+
+    /**
+     * @brief Returns true if withSimulatedClock() was called
+     */
+    bool isSimulated() const { return simulated; };
+
+    /**
+     * @brief Returns the simulated millis() value
+     */
+    unsigned long getSimulatedMillis() const { return (unsigned long) simulatedMillis; };
+
+    /**
+     * @brief Returns true if the system clock has been set, such as by NTP
+     *
+     * The clock is considered to be set if it's after VALID_TIME.
+     */
+    bool isValid() const;
+
+    /**
+     * @brief Time values before this (2021-01-01) are assumed to be from a clock that has not been set
+     */
+    static const time_t VALID_TIME = 1609459200;
+
+protected:
+    /**
+     * @brief Set by withSimulatedClock()
+     */
+    bool simulated = false;
+
+    /**
+     * @brief Unix time when the simulated clock started
+     */
+    time_t simulatedStart = 0;
+
+    /**
+     * @brief Milliseconds since the simulated clock started. 64-bit so the Unix time doesn't 
+     * roll over with millis().
+     */
+    uint64_t simulatedMillis = 0;
+};
+extern DeviceNameHelperPosixTime Time;
+
+/**
+ * @brief Replaces System
+ */
+class DeviceNameHelperPosixSystem {
+public:
+    /**
+     * @brief Registers a system event handler. Only cloud_status and time_changed are generated.
+     */
+    bool on(system_event_t events, void (*handler)(system_event_t event, int param));
+
+    /**
+     * @brief Returns the device ID, set using DeviceNameHelperPosixCloud::withDeviceId()
+     *
+     * The default is the host name.
+     */
+    String deviceID() const;
+
+    /**
+     * @brief Calls the system event handlers registered for event
+     */
+    void notify(system_event_t event, int param);
+
+    /**
+     * @brief Device ID returned by deviceID(), if set
+     */
+    String deviceId;
+
+protected:
+    /**
+     * @brief Handler registered using on()
+     */
+    struct Handler {
+        system_event_t events;
+        void (*handler)(system_event_t event, int param);
+    };
+
+    /**
+     * @brief Handlers registered using on()
+     */
+    std::vector<Handler> handlers;
+};
+extern DeviceNameHelperPosixSystem System;
+
+/**
+ * @brief Replaces Particle, connecting publish and subscribe to your own transport
+ *
+ * There is no cloud connection on Linux. Instead, you set a publish handler that sends the
+ * event by whatever method you use, such as MQTT or a web service, and call receive()
+ * when an event arrives. Call setConnected() when your connection goes up or down.
+ *
+ * Call Particle.process() from your main loop. It calls the process handler, if set, so
+ * you can poll your connection, and generates time_changed when the system clock is set.
+ */
+class DeviceNameHelperPosixCloud {
+public:
+    /**
+     * @brief Sets the function called to publish an event
+     *
+     * @param publishHandler The function. It's passed the event name and event data (which may be
+     * an empty string) and returns true if the event was sent.
+     *
+     * @return *this, so you can chain the withXXX() calls, fluent-style.
+     */
+    DeviceNameHelperPosixCloud &withPublishHandler(std::function<bool(const char *eventName, const char *eventData)> publishHandler) { this->publishHandler = publishHandler; return *this; };
+
+    /**
+     * @brief Sets a function to call from process()
+     *
+     * @return *this, so you can chain the withXXX() calls, fluent-style.
+     */
+    DeviceNameHelperPosixCloud &withProcessHandler(std::function<void()> processHandler) { this->processHandler = processHandler; return *this; };
+
+    /**
+     * @brief Sets the device ID returned by System.deviceID(). The default is the host name.
+     *
+     * @return *this, so you can chain the withXXX() calls, fluent-style.
+     */
+    DeviceNameHelperPosixCloud &withDeviceId(const char *deviceId) { System.deviceId = deviceId; return *this; };
+
+    /**
+     * @brief Sets whether the transport is connected and generates the cloud_status system event
+     */
+    void setConnected(bool connected);
+
+    /**
+     * @brief Passes a received event to the subscription handlers whose prefix matches eventName
+     */
+    void receive(const char *eventName, const char *eventData);
+
+    /**
+     * @brief Returns true if setConnected(true) was called
+     */
+    bool connected() const { return isConnected; };
+
+    /**
+     * @brief Publishes an event using the publish handler
+     *
+     * @return true if the handler sent the event, false if not connected or no handler is set
+     */
+    bool publish(const char *eventName, const char *eventData = "");
+
+    /**
+     * @brief Subscribes to events whose name starts with prefix
+     */
+    bool subscribe(const char *prefix, void (*handler)(const char *eventName, const char *eventData));
+
+    /**
+     * @brief Subscribes to events whose name starts with prefix using a class member function
+     */
+    template<class T>
+    bool subscribe(const char *prefix, void (T::*handler)(const char *eventName, const char *eventData), T *instance) {
+        subscriptions.push_back(Subscription{prefix, [handler, instance](const char *eventName, const char *eventData) {
+            (instance->*handler)(eventName, eventData);
+        }});
+        return true;
+    }
+
+    /**
+     * @brief Removes all subscriptions
+     */
+    void unsubscribe() { subscriptions.clear(); };
+
+    /**
+     * @brief Call from your main loop. Calls the process handler and checks if the time was set.
+     */
+    void process();
+
+protected:
+    /**
+     * @brief A subscription added by subscribe()
+     */
+    struct Subscription {
+        String prefix;
+        std::function<void(const char *eventName, const char *eventData)> handler;
+    };
+
+    /**
+     * @brief Subscriptions added by subscribe()
+     */
+    std::vector<Subscription> subscriptions;
+
+    /**
+     * @brief Function set by withPublishHandler()
+     */
+    std::function<bool(const char *eventName, const char *eventData)> publishHandler;
+
+    /**
+     * @brief Function set by withProcessHandler()
+     */
+    std::function<void()> processHandler;
+
+    /**
+     * @brief Set by setConnected()
+     */
+    bool isConnected = false;
+
+    /**
+     * @brief Value of Time.isValid() on the last call to process()
+     */
+    bool timeWasValid = false;
+};
+extern DeviceNameHelperPosixCloud Particle;
+
+#endif /* __DEVICENAMEHELPERPOSIX_H */
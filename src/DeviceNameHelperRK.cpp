@@ -1,11 +1,53 @@
 #include "DeviceNameHelperRK.h"
 
+static const char *DEVICE_NAME_EVENT = "particle/device/name";
+
 DeviceNameHelper *DeviceNameHelper::_instance = 0;
 
 void DeviceNameHelper::loop() {
+    transport->loop();
+
     if (stateHandler) {
-        stateHandler(*this);
+        (this->*stateHandler)();
     }   
+#if DEVICENAMEHELPER_HAS_COROUTINES
+    if (awaiters) {
+        resumeAwaiters();
+    }
+#endif
+}
+
+DeviceNameHelper::WaitResult DeviceNameHelper::waitForName(std::chrono::milliseconds timeout) {
+    if (!data) {
+        return WaitResult::NOT_SETUP;
+    }
+
+    unsigned long start = millis();
+    while(true) {
+        loop();
+        if (hasName()) {
+            return WaitResult::SUCCESS;
+        }
+        if (!stateHandler || millis() - start >= (unsigned long) timeout.count()) {
+            break;
+        }
+        // Dispatches the subscription handler when not using threads
+        Particle.process();
+
+        // Yields to the system thread when using threads
+        delay(1);
+    }
+
+    if (!transport->isConnected()) {
+        return WaitResult::NO_CONNECTION;
+    }
+    if (!timeValid && transport->requiresValidTime()) {
+        return WaitResult::NO_TIME;
+    }
+    if (budgetThrottled) {
+        return WaitResult::BUDGET_EXCEEDED;
+    }
+    return WaitResult::NO_RESPONSE;
 }
 
 DeviceNameHelper &DeviceNameHelper::withNameCallback(std::function<void(const char *)> nameCallback) {
@@ -13,94 +55,444 @@ DeviceNameHelper &DeviceNameHelper::withNameCallback(std::function<void(const ch
     return *this;
 }
 
+DeviceNameHelper &DeviceNameHelper::withRequestBudget(size_t maxRequests, std::chrono::seconds window) {
+    budgetMax = maxRequests;
+    budgetWindowMs = (unsigned long) window.count() * 1000;
+    budgetTimes.assign(maxRequests, 0);
+    budgetNext = budgetCount = 0;
+    return *this;
+}
+
+DeviceNameHelper &DeviceNameHelper::withNameFormat(DeviceNameHelperFormat &nameFormat) {
+    for(DeviceNameHelperFormat *format = nameFormats; format; format = format->next) {
+        if (format == &nameFormat) {
+            // Already registered. Adding it again would link it to itself.
+            return *this;
+        }
+    }
+
+    nameFormat.next = nameFormats;
+    nameFormats = &nameFormat;
+
+    nameFormat.render(getName());
+    return *this;
+}
+
 
 DeviceNameHelper::DeviceNameHelper() {
+    cloudTransport.attach(this);
 }
 
 DeviceNameHelper::~DeviceNameHelper() {
 }
 
 void DeviceNameHelper::commonSetup() {
-    // Validate data
-    if (data->magic != DATA_MAGIC || data->size != sizeof(DeviceNameHelperData)) {
+    // Validate data. The magic bytes and size are not enough to know the name is
+    // null terminated if the storage was corrupted, and everything that uses the 
+    // name depends on that.
+    if (data->magic != DATA_MAGIC || data->size != sizeof(DeviceNameHelperData) || 
+        memchr(data->name, 0, sizeof(data->name)) == NULL) {
         memset(data, 0, sizeof(DeviceNameHelperData));     
         data->magic = DATA_MAGIC;
         data->size = (uint8_t) sizeof(DeviceNameHelperData);
     }
 
-    stateHandler = &DeviceNameHelper::stateStart;
+    if (!data->name[0] && useFallbackName) {
+        // Use the fallback name until we get the name from the cloud. This is not saved.
+        String deviceId;
+        const char *name = fallbackName;
+        if (!name) {
+            deviceId = System.deviceID();
+            name = deviceId.c_str();
+        }
+        // Copied like a name from the cloud, so it isn't cut off in the middle of a UTF-8 character
+        size_t originalLength;
+        copyName(name, SIZE_MAX, data->name, originalLength);
+        data->flags |= FLAG_PROVISIONAL;
+    }
+
+    updateNameCache();
+
+    if (!hasSystemEvents) {
+        // Get notified of cloud connection and time sync instead of polling for them
+        System.on(cloud_status | time_changed, &DeviceNameHelper::systemEventHandler);
+        hasSystemEvents = true;
+    }
+
+    // The events only report changes, so get the current state now
+    cloudConnected = Particle.connected();
+    timeValid = Time.isValid();
+    lastCheckMs = millis();
+
+    setState(&DeviceNameHelper::stateStart, TraceReason::SETUP);
 }
 
 void DeviceNameHelper::checkName() {
     if (stateHandler == NULL) {
-        stateHandler = &DeviceNameHelper::stateSubscribe;
+        setState(&DeviceNameHelper::stateSubscribe, TraceReason::CHECK_NAME);
         return;
     }
 
     forceCheck = true;
 }
 
+DeviceNameHelperRequest DeviceNameHelper::requestName() {
+    if (!data) {
+        return DeviceNameHelperRequest();
+    }
+
+    if (requestStatus == DeviceNameHelperRequest::Status::PENDING) {
+        // The request in progress will also satisfy this one
+        return DeviceNameHelperRequest(this, requestId);
+    }
+    requestId++;
+    requestStatus = DeviceNameHelperRequest::Status::PENDING;
+    requestStartedCheck = false;
+
+    if (!stateHandler || isState(&DeviceNameHelper::stateWaitRecheck) || 
+        isState(&DeviceNameHelper::stateWaitSession) || isState(&DeviceNameHelper::stateWaitRetry)) {
+        // Idle or waiting, start now
+        waitingForSession = false;
+        requestStartedCheck = true;
+        setState(&DeviceNameHelper::stateSubscribe, TraceReason::REQUEST_NAME);
+    }
+    else if (isState(&DeviceNameHelper::stateStart) && !forceCheck) {
+        forceCheck = true;
+        requestStartedCheck = true;
+    }
+    // Otherwise a request is already in progress and its result is used
+
+    return DeviceNameHelperRequest(this, requestId);
+}
+
+void DeviceNameHelper::sessionStarting() {
+    if (waitingForSession) {
+        waitingForSession = false;
+        setState(&DeviceNameHelper::stateSubscribe, TraceReason::SESSION_STARTING);
+    }
+}
+
 
 void DeviceNameHelper::save() {
     // Overridden by DeviceNameHelperEEPROM
 }
 
+unsigned long DeviceNameHelper::getRetryWaitMs() {
+    while(randomState == 0) {
+        randomState = HAL_RNG_GetRandomNumber();
+    }
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+
+    return RETRY_WAIT_MS - RETRY_JITTER_MS / 2 + (randomState % RETRY_JITTER_MS);
+}
+
+bool DeviceNameHelper::budgetAvailable() const {
+    if (budgetMax == 0 || budgetCount < budgetMax) {
+        return true;
+    }
+    return (millis() - budgetTimes[budgetNext]) >= budgetWindowMs;
+}
+
+void DeviceNameHelper::budgetUsed() {
+    if (budgetMax == 0) {
+        return;
+    }
+    budgetTimes[budgetNext] = millis();
+    budgetNext = (budgetNext + 1) % budgetMax;
+    if (budgetCount < budgetMax) {
+        budgetCount++;
+    }
+}
+
+DeviceNameHelper &DeviceNameHelper::withTransport(DeviceNameHelperTransport &transport) {
+    if (this->transport != &transport) {
+        // Responses from the previous transport, such as the cloud subscription, are ignored
+        this->transport->attach(NULL);
+    }
+    this->transport = &transport;
+    transport.attach(this);
+
+    // Subscribe using the new transport
+    hasSubscribed = false;
+    return *this;
+}
+
+void DeviceNameHelper::addSubscription() {
+    transport->begin();
+}
+
+void DeviceNameHelper::publishRequest() {
+    requestBytes = transport->publishRequest();
+}
+
+bool DeviceNameHelper::isState(void (DeviceNameHelper::*state)()) const {
+    return stateHandler == state;
+}
+
+void DeviceNameHelper::setState(void (DeviceNameHelper::*state)(), TraceReason reason) {
+    if (!trace.empty()) {
+        TraceEntry &entry = trace[traceNext];
+        entry.time = (uint32_t) millis();
+        entry.fromState = getTraceState(stateHandler);
+        entry.toState = getTraceState(state);
+        entry.reason = reason;
+        entry.reserved = 0;
+
+        traceNext = (traceNext + 1) % trace.size();
+        if (traceCount < trace.size()) {
+            traceCount++;
+        }
+    }
+
+    stateHandler = state;
+}
+
+// [static]
+DeviceNameHelper::TraceState DeviceNameHelper::getTraceState(void (DeviceNameHelper::*state)()) {
+    static const struct {
+        void (DeviceNameHelper::*state)();
+        TraceState traceState;
+    } states[] = {
+        { &DeviceNameHelper::stateStart, TraceState::START },
+        { &DeviceNameHelper::stateSubscribe, TraceState::SUBSCRIBE },
+        { &DeviceNameHelper::stateWaitConnected, TraceState::WAIT_CONNECTED },
+        { &DeviceNameHelper::stateWaitRequest, TraceState::WAIT_REQUEST },
+        { &DeviceNameHelper::stateWaitResponse, TraceState::WAIT_RESPONSE },
+        { &DeviceNameHelper::stateWaitRetry, TraceState::WAIT_RETRY },
+        { &DeviceNameHelper::stateWaitRecheck, TraceState::WAIT_RECHECK },
+        { &DeviceNameHelper::stateWaitSession, TraceState::WAIT_SESSION },
+    };
+
+    for(size_t ii = 0; ii < sizeof(states) / sizeof(states[0]); ii++) {
+        if (states[ii].state == state) {
+            return states[ii].traceState;
+        }
+    }
+    return TraceState::NONE;
+}
+
+DeviceNameHelper &DeviceNameHelper::withTrace(size_t size) {
+    trace.assign(size, TraceEntry());
+    traceNext = traceCount = 0;
+    return *this;
+}
+
+bool DeviceNameHelper::getTrace(size_t index, TraceEntry &entry) const {
+    if (index >= traceCount) {
+        return false;
+    }
+    // The oldest entry is at traceNext once the buffer has wrapped, otherwise at 0
+    entry = trace[(traceNext + trace.size() - traceCount + index) % trace.size()];
+    return true;
+}
+
+void DeviceNameHelper::dumpTrace(std::function<void(const char *line)> fn) const {
+    TraceEntry entry;
+    uint32_t lastTime = 0;
+
+    for(size_t ii = 0; ii < traceCount; ii++) {
+        getTrace(ii, entry);
+
+        char line[96];
+        int len = snprintf(line, sizeof(line), "%lu %s -> %s %s", (unsigned long) entry.time, 
+            getStateName(entry.fromState), getStateName(entry.toState), getReasonName(entry.reason));
+        if (ii > 0 && len > 0 && (size_t) len < sizeof(line)) {
+            // How long was spent in fromState, which was entered at the previous entry
+            snprintf(&line[len], sizeof(line) - len, " after %lu ms", (unsigned long) (entry.time - lastTime));
+        }
+        lastTime = entry.time;
+        fn(line);
+    }
+}
+
+// [static]
+const char *DeviceNameHelper::getStateName(TraceState state) {
+    switch(state) {
+        case TraceState::NONE: return "NONE";
+        case TraceState::START: return "START";
+        case TraceState::SUBSCRIBE: return "SUBSCRIBE";
+        case TraceState::WAIT_CONNECTED: return "WAIT_CONNECTED";
+        case TraceState::WAIT_REQUEST: return "WAIT_REQUEST";
+        case TraceState::WAIT_RESPONSE: return "WAIT_RESPONSE";
+        case TraceState::WAIT_RETRY: return "WAIT_RETRY";
+        case TraceState::WAIT_RECHECK: return "WAIT_RECHECK";
+        case TraceState::WAIT_SESSION: return "WAIT_SESSION";
+    }
+    return "UNKNOWN";
+}
+
+// [static]
+const char *DeviceNameHelper::getReasonName(TraceReason reason) {
+    switch(reason) {
+        case TraceReason::SETUP: return "SETUP";
+        case TraceReason::CHECK_NAME: return "CHECK_NAME";
+        case TraceReason::REQUEST_NAME: return "REQUEST_NAME";
+        case TraceReason::SESSION_STARTING: return "SESSION_STARTING";
+        case TraceReason::CANCELLED: return "CANCELLED";
+        case TraceReason::HAVE_NAME: return "HAVE_NAME";
+        case TraceReason::NEED_NAME: return "NEED_NAME";
+        case TraceReason::SUBSCRIBED: return "SUBSCRIBED";
+        case TraceReason::CONNECTED: return "CONNECTED";
+        case TraceReason::DISCONNECTED: return "DISCONNECTED";
+        case TraceReason::REQUEST_SENT: return "REQUEST_SENT";
+        case TraceReason::SEND_FAILED: return "SEND_FAILED";
+        case TraceReason::GOT_NAME: return "GOT_NAME";
+        case TraceReason::NO_NAME: return "NO_NAME";
+        case TraceReason::TIMEOUT: return "TIMEOUT";
+        case TraceReason::RETRY: return "RETRY";
+        case TraceReason::RECHECK_DISABLED: return "RECHECK_DISABLED";
+        case TraceReason::RECHECK_DUE: return "RECHECK_DUE";
+        case TraceReason::DEFERRED: return "DEFERRED";
+    }
+    return "UNKNOWN";
+}
+
+void DeviceNameHelper::completeRequest(DeviceNameHelperRequest::Status status) {
+    if (requestStatus == DeviceNameHelperRequest::Status::PENDING) {
+        requestStatus = status;
+    }
+}
+
+void DeviceNameHelper::updateNameCache() {
+    nameLength = strlen(data->name);
+    nameHash = hashName(data->name, nameLength);
+
+    for(DeviceNameHelperFormat *nameFormat = nameFormats; nameFormat; nameFormat = nameFormat->next) {
+        nameFormat->render(data->name);
+    }
+
+    // Release so a reader that sees the new generation also sees the new name
+    nameGeneration.fetch_add(1, std::memory_order_release);
+}
+
+// [static]
+uint32_t DeviceNameHelper::hashName(const char *str, size_t len) {
+    // 32-bit FNV-1a
+    uint32_t hash = 2166136261UL;
+    for(size_t ii = 0; ii < len; ii++) {
+        hash ^= (uint8_t) str[ii];
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+
 void DeviceNameHelper::stateStart() {
-    if (data->name[0]) {
-        // We have a name and we are not rechecking
+    if (hasName()) {
         if (nameCallback) {
             nameCallback(data->name);
         }
-        stateHandler = &DeviceNameHelper::stateWaitRecheck;
-        stateTime = millis();
-        return;
+        if (!forceCheck) {
+            // We have a name and we are not rechecking
+            setState(&DeviceNameHelper::stateWaitRecheck, TraceReason::HAVE_NAME);
+            recheckScheduled = false;
+            return;
+        }
     }
 
     // Subscribe
-    stateHandler = &DeviceNameHelper::stateSubscribe;
+    setState(&DeviceNameHelper::stateSubscribe, TraceReason::NEED_NAME);
 }
 
 
 void DeviceNameHelper::stateSubscribe() {
+    // This check satisfies any pending checkName()
+    forceCheck = false;
 
     if (!hasSubscribed) {
         // Add a subscription handler for the device name event
-        Particle.subscribe("particle/device/name", &DeviceNameHelper::subscriptionHandler, this);
+        addSubscription();
         hasSubscribed = true;
     }
 
-    stateHandler = &DeviceNameHelper::stateWaitConnected;
+    setState(&DeviceNameHelper::stateWaitConnected, TraceReason::SUBSCRIBED);
 }
 
 void DeviceNameHelper::stateWaitConnected() {
-    if (!Particle.connected() || !Time.isValid()) {
+    if (!transport->isConnected() || (!timeValid && transport->requiresValidTime())) {
         // Not connected or do not have the time yet
         return;
     }
 
-    stateHandler = &DeviceNameHelper::stateWaitRequest;
+    setState(&DeviceNameHelper::stateWaitRequest, TraceReason::CONNECTED);
     stateTime = millis();
 }
 
 void DeviceNameHelper::stateWaitRequest() {
+    if (!transport->isConnected()) {
+        // Lost the connection before making the request
+        setState(&DeviceNameHelper::stateWaitConnected, TraceReason::DISCONNECTED);
+        return;
+    }
+
     // Wait a few seconds for the subscription to complete
-    if (millis() - stateTime < POST_CONNECT_WAIT_MS) {
+    if (millis() - stateTime < transport->getConnectWaitMs()) {
+        return;
+    }
+
+    if (!budgetAvailable()) {
+        // Too many requests recently; wait until the oldest one leaves the window
+        if (!budgetThrottled) {
+            budgetThrottled = true;
+            stats.throttledRequestCount++;
+        }
         return;
     }
+    budgetThrottled = false;
+    budgetUsed();
+
     // Now request device name
     gotResponse = false;
-    Particle.publish("particle/device/name");
+    awaitingResponse = true;
+    requestBytes = 0;
+    publishRequest();
+    int sent = requestBytes;
+    if (sent < 0) {
+        // Could not send the request, so there won't be a response
+        awaitingResponse = false;
+        stats.sendFailedCount++;
+        completeRequest(DeviceNameHelperRequest::Status::FAILED);
+        retryWaitMs = getRetryWaitMs();
+        setState(&DeviceNameHelper::stateWaitRetry, TraceReason::SEND_FAILED);
+        stateTime = millis();
+        return;
+    }
+    stats.requestCount++;
+    if (transport->usesDataOperations()) {
+        stats.dataOperations++;
+    }
+    stats.bytesSent += sent;
 
-    stateHandler = &DeviceNameHelper::stateWaitResponse;
+    setState(&DeviceNameHelper::stateWaitResponse, TraceReason::REQUEST_SENT);
     stateTime = millis();
 }
 
 void DeviceNameHelper::stateWaitResponse() {
     if (gotResponse) {
+        stats.responseWaitMs += millis() - stateTime;
+
         // Got a response
-        if (data->name[0]) {
+        if (responseName[0]) {
             // And a name
-            data->lastCheck = Time.now();
+            if (strcmp(data->name, responseName) != 0) {
+                strcpy(data->name, responseName);
+                updateNameCache();
+                completeRequest(DeviceNameHelperRequest::Status::CHANGED);
+            }
+            else {
+                completeRequest(DeviceNameHelperRequest::Status::UNCHANGED);
+            }
+            data->flags &= ~FLAG_PROVISIONAL;
+            if (responseTruncated) {
+                data->flags |= FLAG_TRUNCATED;
+            }
+            else {
+                data->flags &= ~FLAG_TRUNCATED;
+            }
+            data->originalLength = responseOriginalLength;
+            data->lastCheck = timeValid ? Time.now() : 0;
+            lastCheckMs = millis();
             save();
 
             if (nameCallback) {
@@ -108,78 +500,414 @@ void DeviceNameHelper::stateWaitResponse() {
             }
 
             // Recheck later
-            stateHandler = &DeviceNameHelper::stateWaitRecheck;
-            stateTime = millis();
+            setState(&DeviceNameHelper::stateWaitRecheck, TraceReason::GOT_NAME);
+            recheckScheduled = false;
             return;
         } else {
             // Got a response but no name. Try again in a few minutes.
-            stateHandler = &DeviceNameHelper::stateWaitRetry;
+            completeRequest(DeviceNameHelperRequest::Status::FAILED);
+            retryWaitMs = getRetryWaitMs();
+            setState(&DeviceNameHelper::stateWaitRetry, TraceReason::NO_NAME);
             stateTime = millis();
             return;
         }
     }
 
+    if (!transport->isConnected()) {
+        // The response can't arrive while disconnected, so don't wait for the timeout
+        // and retry period. Make the request again as soon as we're back online.
+        awaitingResponse = false;
+        stats.abortedRequestCount++;
+        stats.responseWaitMs += millis() - stateTime;
+        setState(&DeviceNameHelper::stateWaitConnected, TraceReason::DISCONNECTED);
+        return;
+    }
+
     if (millis() - stateTime >= RESPONSE_WAIT_MS) {
-        // Did not get a response
-        stateHandler = &DeviceNameHelper::stateWaitRetry;
+        // Did not get a response. If it arrives later it will be ignored.
+        awaitingResponse = false;
+        completeRequest(DeviceNameHelperRequest::Status::FAILED);
+        stats.responseWaitMs += millis() - stateTime;
+        retryWaitMs = getRetryWaitMs();
+        setState(&DeviceNameHelper::stateWaitRetry, TraceReason::TIMEOUT);
         stateTime = millis();
         return;
     }
 }
 
 void DeviceNameHelper::stateWaitRetry() {
-    if (millis() - stateTime >= RETRY_WAIT_MS) {
+    if (millis() - stateTime >= retryWaitMs) {
         // Time to retry
-        stateHandler = &DeviceNameHelper::stateWaitConnected;
+        setState(&DeviceNameHelper::stateWaitConnected, TraceReason::RETRY);
         return;
     }
 }
 
 void DeviceNameHelper::stateWaitRecheck() {
-    if (millis() - stateTime < 10000) {
-        return;
-    }
-    stateTime = millis();
-
-    // Only do these checks every 10 seconds
-
     if (forceCheck) {
-        forceCheck = false;
-        stateHandler = &DeviceNameHelper::stateSubscribe;
+        // checkName() was called. stateSubscribe clears forceCheck.
+        setState(&DeviceNameHelper::stateSubscribe, TraceReason::CHECK_NAME);
         return;
     }
 
     if (checkPeriod.count() == 0) {
         // Recheck disabled, so nothing more to do
-        stateHandler = 0;
+        setState(NULL, TraceReason::RECHECK_DISABLED);
+        return;
+    }
+
+    long remaining;
+    if (!recheckScheduled) {
+        // Convert the time until the next check into a millis() deadline so we don't 
+        // need to check the clock on every loop
+        if (!getRecheckRemaining(remaining)) {
+            return;
+        }
+        if (remaining < 0) {
+            remaining = 0;
+        }
+        if (remaining > (long) MAX_RECHECK_WAIT_S) {
+            // Long periods are done in steps so millis() can't roll over
+            remaining = MAX_RECHECK_WAIT_S;
+        }
+        recheckWaitMs = (unsigned long) remaining * 1000;
+        recheckScheduled = true;
+        stateTime = millis();
+    }
+
+    if (millis() - stateTime < recheckWaitMs) {
         return;
     }
+    recheckScheduled = false;
 
-    if (Time.isValid() && (data->lastCheck + checkPeriod.count()) < Time.now()) {
+    if (getRecheckRemaining(remaining) && remaining <= 0) {
         // Time to check name again
+        if (deferRecheck) {
+            // Wait for the app to tell us it's going to connect
+            waitingForSession = true;
+            setState(&DeviceNameHelper::stateWaitSession, TraceReason::DEFERRED);
+            return;
+        }
+
         // Go to the stateSubscribe because if we have a saved name we might not
         // have added a subscription yet. If we have one we won't subscribe again.
-        stateHandler = &DeviceNameHelper::stateSubscribe;
+        setState(&DeviceNameHelper::stateSubscribe, TraceReason::RECHECK_DUE);
         return;
     }
 }
 
+bool DeviceNameHelper::getRecheckRemaining(long &remaining) const {
+    if (timeValid && (data->lastCheck != 0 || transport->requiresValidTime())) {
+        remaining = data->lastCheck + checkPeriod.count() - Time.now();
+        return true;
+    }
+    if (!transport->requiresValidTime()) {
+        // Without the time, count the period from the last check in this boot, or from setup
+        remaining = checkPeriod.count() - (long)((millis() - lastCheckMs) / 1000);
+        return true;
+    }
+    return false;
+}
+
+void DeviceNameHelper::stateWaitSession() {
+    // sessionStarting() moves to stateSubscribe directly
+    if (forceCheck) {
+        forceCheck = false;
+        waitingForSession = false;
+        setState(&DeviceNameHelper::stateSubscribe, TraceReason::CHECK_NAME);
+    }
+}
+
 
 
 void DeviceNameHelper::subscriptionHandler(const char *eventName, const char *eventData) {
+    if (!eventData) {
+        eventData = "";
+    }
 
-    if (strlen(eventData) < DEVICENAMEHELPER_MAX_NAME_LEN) {
-        // Fits
-        strcpy(data->name, eventData);
+    stats.responseCount++;
+    if (transport->usesDataOperations()) {
+        stats.dataOperations++;
     }
-    else {
-        // Need to truncate
-        strncpy(data->name, eventData, DEVICENAMEHELPER_MAX_NAME_LEN);
-        data->name[DEVICENAMEHELPER_MAX_NAME_LEN] = 0;
+    stats.bytesReceived += strlen(eventName);
+
+    if (!awaitingResponse) {
+        // Duplicate, or a response to a request that already timed out or was
+        // aborted. Only the first response to the outstanding request is used.
+        stats.ignoredResponseCount++;
+        stats.bytesReceived += strlen(eventData);
+        return;
     }
+    awaitingResponse = false;
+
+    // The name is only copied into data by stateWaitResponse so storage is only
+    // updated from the state machine
+    size_t originalLength;
+    responseTruncated = copyName(eventData, SIZE_MAX, responseName, originalLength);
+    responseOriginalLength = (originalLength < 0xffff) ? (uint16_t) originalLength : 0xffff;
+    stats.bytesReceived += originalLength;
+
     gotResponse = true;
 }
 
+// [static]
+void DeviceNameHelper::systemEventHandler(system_event_t event, int param) {
+    if (_instance) {
+        updateSystemFlags(event, param, _instance->cloudConnected, _instance->timeValid);
+    }
+}
+
+// [static]
+void DeviceNameHelper::updateSystemFlags(system_event_t event, int param, volatile bool &cloudConnected, volatile bool &timeValid) {
+    if (event == cloud_status) {
+        if (param == cloud_status_connected) {
+            cloudConnected = true;
+        }
+        else if (param == cloud_status_disconnected || param == cloud_status_disconnecting) {
+            cloudConnected = false;
+        }
+    }
+    else if (event == time_changed) {
+        // Either a cloud time sync or Time.setTime(), both make the time valid
+        timeValid = true;
+    }
+}
+
+// [static]
+bool DeviceNameHelper::copyName(const char *src, size_t srcLen, char *dst, size_t &originalLength) {
+    if (!src) {
+        src = "";
+    }
+
+    size_t len = 0;
+    while(len < srcLen && src[len] && len < DEVICENAMEHELPER_MAX_NAME_LEN) {
+        dst[len] = src[len];
+        len++;
+    }
+
+    originalLength = len;
+    bool truncated = (len < srcLen && src[len] != 0);
+    if (truncated) {
+        // Need to truncate. Finish counting the length from where the copy stopped.
+        while(originalLength < srcLen && src[originalLength]) {
+            originalLength++;
+        }
+
+        // If the first byte not copied is a UTF-8 continuation byte (10xxxxxx), we're in
+        // the middle of a multi-byte character. Remove the continuation bytes that were
+        // copied and the lead byte (11xxxxxx) so the name is still valid UTF-8.
+        if ((src[len] & 0xc0) == 0x80) {
+            while(len > 0 && (dst[len - 1] & 0xc0) == 0x80) {
+                len--;
+            }
+            if (len > 0 && (dst[len - 1] & 0xc0) == 0xc0) {
+                len--;
+            }
+        }
+    }
+    dst[len] = 0;
+    return truncated;
+}
+
+#if DEVICENAMEHELPER_HAS_COROUTINES
+DeviceNameHelperAwaiter DeviceNameHelper::awaitName(std::chrono::milliseconds timeout) {
+    return DeviceNameHelperAwaiter(*this, timeout);
+}
+
+void DeviceNameHelper::resumeAwaiters() {
+    // Detach the list first, since a resumed coroutine can co_await again
+    resumeList = awaiters;
+    awaiters = 0;
+
+    while(resumeList) {
+        DeviceNameHelperAwaiter *awaiter = resumeList;
+        resumeList = resumeList->next;
+
+        if (hasName() || (awaiter->timeoutMs && millis() - awaiter->startMs >= awaiter->timeoutMs)) {
+            // The awaiter is in the coroutine frame, so don't use it after resuming
+            awaiter->handle.resume();
+        }
+        else {
+            awaiter->next = awaiters;
+            awaiters = awaiter;
+        }
+    }
+}
+
+//
+// DeviceNameHelperAwaiter
+//
+
+DeviceNameHelperAwaiter::~DeviceNameHelperAwaiter() {
+    DeviceNameHelperAwaiter **lists[2] = { &helper.awaiters, &helper.resumeList };
+
+    for(size_t ii = 0; ii < 2; ii++) {
+        for(DeviceNameHelperAwaiter **pp = lists[ii]; *pp; pp = &(*pp)->next) {
+            if (*pp == this) {
+                *pp = next;
+                return;
+            }
+        }
+    }
+}
+
+void DeviceNameHelperAwaiter::await_suspend(std::coroutine_handle<> handle) {
+    this->handle = handle;
+    startMs = millis();
+
+    next = helper.awaiters;
+    helper.awaiters = this;
+}
+#endif /* DEVICENAMEHELPER_HAS_COROUTINES */
+
+//
+// DeviceNameHelperRequest
+//
+
+DeviceNameHelperRequest::Status DeviceNameHelperRequest::status() const {
+    if (!helper || id == 0) {
+        return Status::FAILED;
+    }
+    if (id != helper->requestId) {
+        return Status::SUPERSEDED;
+    }
+    return helper->requestStatus;
+}
+
+void DeviceNameHelperRequest::cancel() {
+    if (status() != Status::PENDING) {
+        return;
+    }
+    helper->requestStatus = Status::CANCELLED;
+
+    if (!helper->requestStartedCheck) {
+        // Joined a check that was already in progress. Let it finish so the periodic 
+        // schedule (lastCheck) is updated; only the handle is cancelled.
+    }
+    else if (helper->isState(&DeviceNameHelper::stateStart)) {
+        // Not started yet
+        helper->forceCheck = false;
+    }
+    else if (helper->hasName() && helper->stateHandler && !helper->isState(&DeviceNameHelper::stateWaitRecheck)) {
+        // The name is known so there's no need to continue. Go back to waiting for the
+        // next periodic check. A response that arrives later will be ignored.
+        helper->awaitingResponse = false;
+        helper->setState(&DeviceNameHelper::stateWaitRecheck, DeviceNameHelper::TraceReason::CANCELLED);
+        helper->recheckScheduled = false;
+    }
+}
+
+//
+// DeviceNameHelperTransport
+//
+
+bool DeviceNameHelperTransport::isConnected() const {
+    return helper && helper->cloudConnected;
+}
+
+unsigned long DeviceNameHelperTransport::getConnectWaitMs() const {
+    return DeviceNameHelper::POST_CONNECT_WAIT_MS;
+}
+
+void DeviceNameHelperTransport::nameReceived(const char *eventName, const char *name) {
+    if (helper) {
+        helper->subscriptionHandler(eventName, name);
+    }
+}
+
+//
+// DeviceNameHelperCloudTransport
+//
+
+void DeviceNameHelperCloudTransport::begin() {
+    Particle.subscribe(DEVICE_NAME_EVENT, &DeviceNameHelperCloudTransport::subscriptionHandler, this);
+}
+
+int DeviceNameHelperCloudTransport::publishRequest() {
+    if (!Particle.publish(DEVICE_NAME_EVENT)) {
+        return -1;
+    }
+    return (int) strlen(DEVICE_NAME_EVENT);
+}
+
+void DeviceNameHelperCloudTransport::subscriptionHandler(const char *eventName, const char *eventData) {
+    nameReceived(eventName, eventData);
+}
+
+//
+// DeviceNameHelperLoopbackTransport
+//
+
+void DeviceNameHelperLoopbackTransport::loop() {
+    if (pending) {
+        pending = false;
+        nameReceived("", name);
+    }
+}
+
+#if !DEVICENAMEHELPER_POSIX
+//
+// DeviceNameHelperStreamTransport
+//
+
+int DeviceNameHelperStreamTransport::publishRequest() {
+    // Discard the rest of any old response
+    lineLen = 0;
+    while(stream.available() > 0) {
+        stream.read();
+    }
+
+    size_t len = strlen(DEVICE_NAME_EVENT);
+    if (stream.write((const uint8_t *)DEVICE_NAME_EVENT, len) != len || stream.write('\n') != 1) {
+        return -1;
+    }
+    return (int) len + 1;
+}
+
+void DeviceNameHelperStreamTransport::loop() {
+    while(stream.available() > 0) {
+        int c = stream.read();
+        if (c < 0) {
+            break;
+        }
+        if (c == '\n') {
+            if (lineLen > 0 && line[lineLen - 1] == '\r') {
+                lineLen--;
+            }
+            line[lineLen] = 0;
+            lineLen = 0;
+            nameReceived("", line);
+        }
+        else if (lineLen < sizeof(line) - 1) {
+            line[lineLen++] = (char) c;
+        }
+    }
+}
+#endif /* !DEVICENAMEHELPER_POSIX */
+
+//
+// DeviceNameHelperFormat
+//
+
+DeviceNameHelperFormat::DeviceNameHelperFormat(const char *format, char *buf, size_t bufSize) : 
+    format(format), buf(buf), bufSize(bufSize) {
+    if (bufSize) {
+        buf[0] = 0;
+    }
+}
+
+void DeviceNameHelperFormat::render(const char *name) {
+    if (bufSize) {
+        if (name && name[0]) {
+            snprintf(buf, bufSize, format, name);
+        }
+        else {
+            // No name yet, so leave it empty instead of formatting "fleet//telemetry"
+            buf[0] = 0;
+        }
+    }
+}
+
 //
 // DeviceNameHelperNoStorage
 //
@@ -204,7 +932,7 @@ DeviceNameHelperNoStorage::~DeviceNameHelperNoStorage() {
 
 }
 
-
+#if !DEVICENAMEHELPER_POSIX
 //
 // DeviceNameHelperEEPROM
 //
@@ -235,7 +963,7 @@ DeviceNameHelperEEPROM::~DeviceNameHelperEEPROM() {
 void DeviceNameHelperEEPROM::save() {
     EEPROM.put(eepromStart, eepromData);
 }
-
+#endif /* !DEVICENAMEHELPER_POSIX */
 
 //
 // DeviceNameHelperRetained
@@ -283,7 +1011,7 @@ void DeviceNameHelperFile::setup(const char *path) {
     this->data = &fileData;
 
     // Read file
-    int fd = open(path, O_RDWR | O_CREAT);
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
     if (fd != -1) {
         int count = read(fd, &fileData, sizeof(DeviceNameHelperData));
         if (count != sizeof(DeviceNameHelperData)) {
@@ -304,7 +1032,7 @@ DeviceNameHelperFile::~DeviceNameHelperFile() {
 
 void DeviceNameHelperFile::save() {
     // Save to file
-    int fd = open(path, O_RDWR | O_CREAT);
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
     if (fd != -1) {
         write(fd, &fileData, sizeof(DeviceNameHelperData));
         close(fd);   
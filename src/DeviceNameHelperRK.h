@@ -4,7 +4,37 @@
 // Github: https://github.com/rickkas7/DeviceNameHelperRK
 // License: MIT
 
+#ifndef DEVICENAMEHELPER_POSIX
+#if defined(PARTICLE)
+#define DEVICENAMEHELPER_POSIX 0
+#else
+/**
+ * @brief Defined to 1 when building for Linux or another POSIX system instead of Device OS
+ *
+ * The parts of the Device OS API used by this library are then provided by DeviceNameHelperPosix.h.
+ */
+#define DEVICENAMEHELPER_POSIX 1
+#endif
+#endif
+
+#if DEVICENAMEHELPER_POSIX
+#include "DeviceNameHelperPosix.h"
+#else
 #include "Particle.h"
+#endif
+
+#include <atomic>
+#include <vector>
+
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#include <coroutine>
+/**
+ * @brief Defined to 1 if the compiler supports C++20 coroutines and DeviceNameHelper::awaitName() is available
+ */
+#define DEVICENAMEHELPER_HAS_COROUTINES 1
+#endif
+#endif
 
 /**
  * @brief The maximum name of the device name in characters
@@ -40,17 +70,22 @@ struct DeviceNameHelperData { // 44 bytes
     uint8_t     size;
 
     /**
-     * @brief Flag bits, not currently used. Currently 0.
+     * @brief Flag bits, DeviceNameHelper::FLAG_TRUNCATED and DeviceNameHelper::FLAG_PROVISIONAL.
      */
     uint8_t     flags;
 
     /**
-     * @brief Reserved for future use, currently 0.
+     * @brief Length of the name received from the cloud, in bytes
+     * 
+     * This is longer than the name if it was truncated to DEVICENAMEHELPER_MAX_NAME_LEN.
+     * Data saved by older versions have 0 here.
      */
-    uint16_t    reserved;
+    uint16_t    originalLength;
 
     /**
      * @brief Last time the name was checked from Time.now() (seconds past January 1, 1970, UTC).
+     * 
+     * 0 if the time was not valid when the name was checked.
      */
     long        lastCheck;
 
@@ -60,6 +95,494 @@ struct DeviceNameHelperData { // 44 bytes
     char        name[DEVICENAMEHELPER_MAX_NAME_LEN + 1];
 };
 
+/**
+ * @brief A string built from a printf-style format and the device name
+ * 
+ * The format must contain exactly one %s, which is replaced by the device name, for
+ * example "fleet/%s/telemetry". Register it with DeviceNameHelper::withNameFormat()
+ * and it's formatted again only when the name changes, so c_str() can be used
+ * from code that publishes frequently without calling snprintf each time.
+ * 
+ * You normally use DeviceNameHelperFormatBuffer, which includes the buffer. This class 
+ * can be used directly if you want to supply your own buffer. The object must not
+ * be deleted once registered, so it's typically a global variable.
+ */
+class DeviceNameHelperFormat {
+public:
+    /**
+     * @brief Construct a format object that writes to a buffer you provide
+     * 
+     * @param format The printf-style format containing one %s. The string is not copied,
+     * so it's typically a string literal.
+     * 
+     * @param buf The buffer to write to
+     * 
+     * @param bufSize The size of buf in bytes, including the null terminator. The result
+     * is truncated if it doesn't fit.
+     */
+    DeviceNameHelperFormat(const char *format, char *buf, size_t bufSize);
+
+    /**
+     * @brief Returns the formatted string
+     * 
+     * This is an empty string until the object is registered with withNameFormat()
+     * and the name (or fallback name) is known.
+     */
+    const char *c_str() const { return buf; };
+
+    /**
+     * @brief Format the string using name. Called by DeviceNameHelper.
+     * 
+     * If name is empty, the string is set to an empty string.
+     */
+    void render(const char *name);
+
+protected:
+    /**
+     * @brief The printf-style format passed to the constructor
+     */
+    const char *format;
+
+    /**
+     * @brief The buffer to write the formatted string to
+     */
+    char *buf;
+
+    /**
+     * @brief Size of buf in bytes
+     */
+    size_t bufSize;
+
+    /**
+     * @brief Next format object registered with the same DeviceNameHelper
+     */
+    DeviceNameHelperFormat *next = 0;
+
+    friend class DeviceNameHelper;
+};
+
+/**
+ * @brief A DeviceNameHelperFormat that includes a buffer of SIZE bytes
+ * 
+ * For example:
+ * 
+ * DeviceNameHelperFormatBuffer<64> telemetryTopic("fleet/%s/telemetry");
+ */
+template<size_t SIZE>
+class DeviceNameHelperFormatBuffer : public DeviceNameHelperFormat {
+public:
+    /**
+     * @brief Construct a format object
+     * 
+     * @param format The printf-style format containing one %s. The string is not copied,
+     * so it's typically a string literal.
+     */
+    explicit DeviceNameHelperFormatBuffer(const char *format) : DeviceNameHelperFormat(format, staticBuf, SIZE) {};
+
+protected:
+    /**
+     * @brief Buffer for the formatted string
+     */
+    char staticBuf[SIZE];
+};
+
+/**
+ * @brief Counters for the cloud usage caused by DeviceNameHelper
+ * 
+ * Returned by DeviceNameHelper::getStats(). These are not saved, and start at 0 
+ * on every restart.
+ */
+struct DeviceNameHelperStats {
+    /**
+     * @brief Number of times the name request event has been published
+     */
+    uint32_t requestCount = 0;
+
+    /**
+     * @brief Number of requests abandoned because the cloud disconnected before the response arrived
+     */
+    uint32_t abortedRequestCount = 0;
+
+    /**
+     * @brief Number of requests the transport could not send. These are not included in requestCount.
+     */
+    uint32_t sendFailedCount = 0;
+
+    /**
+     * @brief Number of device name events received, including ignored ones
+     */
+    uint32_t responseCount = 0;
+
+    /**
+     * @brief Number of device name events discarded because no request was outstanding
+     */
+    uint32_t ignoredResponseCount = 0;
+
+    /**
+     * @brief Number of data operations used. Each publish and each event received is one
+     * data operation. Only transports that use the cloud, such as the default 
+     * DeviceNameHelperCloudTransport, are counted.
+     */
+    uint32_t dataOperations = 0;
+
+    /**
+     * @brief Number of bytes of event name and data published
+     */
+    uint32_t bytesSent = 0;
+
+    /**
+     * @brief Number of bytes of event name and data received
+     */
+    uint32_t bytesReceived = 0;
+
+    /**
+     * @brief Total time spent waiting for responses, in milliseconds
+     * 
+     * This is an estimate of how much radio-on time is attributable to fetching the name.
+     * It's the time from publishing each request until the response, timeout, or disconnect,
+     * which is how long the connection has to stay up for the name to be retrieved.
+     */
+    uint32_t responseWaitMs = 0;
+
+    /**
+     * @brief Number of times a request was delayed because of withRequestBudget()
+     */
+    uint32_t throttledRequestCount = 0;
+};
+
+#if DEVICENAMEHELPER_HAS_COROUTINES
+class DeviceNameHelperAwaiter;
+#endif
+
+class DeviceNameHelper;
+
+/**
+ * @brief Handle returned by DeviceNameHelper::requestName() to check on the request
+ * 
+ * This is a small value object (a pointer and a sequence number) that can be copied
+ * freely. Only the most recent request is tracked by DeviceNameHelper, so a handle for
+ * an older request returns Status::SUPERSEDED once a newer request has been started.
+ */
+class DeviceNameHelperRequest {
+public:
+    /**
+     * @brief State of the request
+     */
+    enum class Status {
+        PENDING,        //!< The request is in progress
+        CHANGED,        //!< The name was retrieved and it's different than before
+        UNCHANGED,      //!< The name was retrieved and it's the same as before
+        FAILED,         //!< No response or an empty name. The name will be requested again later.
+        CANCELLED,      //!< cancel() was called
+        SUPERSEDED      //!< A newer request was started after this one completed
+    };
+
+    /**
+     * @brief Default constructor. status() returns FAILED.
+     */
+    DeviceNameHelperRequest() {};
+
+    /**
+     * @brief Constructor, used by DeviceNameHelper::requestName()
+     */
+    DeviceNameHelperRequest(DeviceNameHelper *helper, uint32_t id) : helper(helper), id(id) {};
+
+    /**
+     * @brief Returns the state of the request
+     */
+    Status status() const;
+
+    /**
+     * @brief Returns true if the request is no longer pending
+     */
+    bool isDone() const { return status() != Status::PENDING; };
+
+    /**
+     * @brief Cancels the request if it's still pending
+     * 
+     * If the name is already known and requestName() started the check, it's stopped and
+     * a response that arrives later is ignored. If the request joined a periodic or checkName()
+     * check that was already in progress, or there's no name yet, the library continues 
+     * the check, but this request will still return CANCELLED.
+     */
+    void cancel();
+
+protected:
+    /**
+     * @brief The DeviceNameHelper that started the request
+     */
+    DeviceNameHelper *helper = 0;
+
+    /**
+     * @brief Sequence number of the request, 0 if not valid
+     */
+    uint32_t id = 0;
+};
+
+/**
+ * @brief Interface for the method used to request the name and receive the response
+ * 
+ * The default is DeviceNameHelperCloudTransport, which uses the "particle/device/name" 
+ * event. You can use a different transport with DeviceNameHelper::withTransport(), such as
+ * DeviceNameHelperStreamTransport to get the name from a gateway over serial, or 
+ * DeviceNameHelperLoopbackTransport for testing. The caching, retry, and request budget
+ * logic in DeviceNameHelper is the same for all transports.
+ * 
+ * To implement your own transport, subclass this and implement begin() and publishRequest().
+ * When the response arrives, call nameReceived().
+ */
+class DeviceNameHelperTransport {
+public:
+    /**
+     * @brief Destructor
+     */
+    virtual ~DeviceNameHelperTransport() {};
+
+    /**
+     * @brief Called once before the first request, to subscribe to the response
+     * 
+     * It's called again if DeviceNameHelper::subscriptionRemoved() is called.
+     */
+    virtual void begin() = 0;
+
+    /**
+     * @brief Send the request for the name
+     * 
+     * @return The number of bytes sent, for DeviceNameHelperStats, or -1 if the request
+     * could not be sent. If the request was not sent, DeviceNameHelper waits to retry.
+     */
+    virtual int publishRequest() = 0;
+
+    /**
+     * @brief Called from DeviceNameHelper::loop(). Use this to poll for the response.
+     */
+    virtual void loop() {};
+
+    /**
+     * @brief Returns true if a request can be made now
+     * 
+     * The default is true when the Particle cloud is connected.
+     */
+    virtual bool isConnected() const;
+
+    /**
+     * @brief How long to wait after connecting before making the request, for the subscription
+     * to be activated (milliseconds)
+     * 
+     * The default is DeviceNameHelper::POST_CONNECT_WAIT_MS (2 seconds).
+     */
+    virtual unsigned long getConnectWaitMs() const;
+
+    /**
+     * @brief Returns true if a request can only be made once the time is valid
+     * 
+     * The default is true. The time is used to schedule periodic checks; a transport 
+     * that doesn't need the cloud can return false so the name can be retrieved before
+     * the time is set. Periodic checks still wait for a valid time.
+     */
+    virtual bool requiresValidTime() const { return true; };
+
+    /**
+     * @brief Returns true if requests and responses use cloud data operations
+     * 
+     * The default is false. Only these transports are counted in DeviceNameHelperStats::dataOperations.
+     */
+    virtual bool usesDataOperations() const { return false; };
+
+    /**
+     * @brief Sets the DeviceNameHelper this transport delivers responses to
+     * 
+     * This is called by DeviceNameHelper::withTransport(). When a different transport is
+     * set, the previous one is detached by passing NULL, and responses it receives
+     * later are ignored.
+     */
+    void attach(DeviceNameHelper *helper) { this->helper = helper; };
+
+protected:
+    /**
+     * @brief Call when the response is received
+     * 
+     * @param eventName Event name or other source of the response, only used to count
+     * bytes received. Use an empty string if there isn't one.
+     * 
+     * @param name The name, or an empty string or NULL if there was no name
+     */
+    void nameReceived(const char *eventName, const char *name);
+
+    /**
+     * @brief The DeviceNameHelper that responses are delivered to
+     */
+    DeviceNameHelper *helper = 0;
+};
+
+/**
+ * @brief Default transport, using the "particle/device/name" cloud event
+ */
+class DeviceNameHelperCloudTransport : public DeviceNameHelperTransport {
+public:
+    /**
+     * @brief Subscribes to the "particle/device/name" event
+     */
+    virtual void begin();
+
+    /**
+     * @brief Publishes the "particle/device/name" event to request the name
+     */
+    virtual int publishRequest();
+
+    /**
+     * @brief Returns true; each publish and each response is a data operation
+     */
+    virtual bool usesDataOperations() const { return true; };
+
+protected:
+    /**
+     * @brief Subscription handler for the "particle/device/name" event
+     */
+    void subscriptionHandler(const char *eventName, const char *eventData);
+};
+
+/**
+ * @brief Transport that responds with a fixed name, without using the cloud
+ * 
+ * The response is delivered on the next call to loop() after the request, so it
+ * goes through the same code path as a response from the cloud. Useful for testing,
+ * and on host builds without a cloud connection.
+ */
+class DeviceNameHelperLoopbackTransport : public DeviceNameHelperTransport {
+public:
+    /**
+     * @brief Constructor
+     * 
+     * @param name The name to respond with. The string is not copied and must remain
+     * valid, such as a string literal. An empty string responds without a name.
+     */
+    DeviceNameHelperLoopbackTransport(const char *name) : name(name) {};
+
+    /**
+     * @brief Sets whether isConnected() returns true, to test disconnection. Default is true.
+     * 
+     * @return *this, so you can chain the withXXX() calls, fluent-style.
+     */
+    DeviceNameHelperLoopbackTransport &withConnected(bool connected) { this->connected = connected; return *this; };
+
+    /**
+     * @brief Does nothing, there's nothing to subscribe to
+     */
+    virtual void begin() {};
+
+    /**
+     * @brief Queues the response for the next loop()
+     */
+    virtual int publishRequest() { pending = true; return 0; };
+
+    /**
+     * @brief Delivers the response, if a request was made
+     */
+    virtual void loop();
+
+    /**
+     * @brief Returns the value set by withConnected()
+     */
+    virtual bool isConnected() const { return connected; };
+
+    /**
+     * @brief There's no subscription, so there's no need to wait after connecting
+     */
+    virtual unsigned long getConnectWaitMs() const { return 0; };
+
+    /**
+     * @brief Returns false; the time is not needed to make a request
+     */
+    virtual bool requiresValidTime() const { return false; };
+
+protected:
+    /**
+     * @brief Name to respond with
+     */
+    const char *name;
+
+    /**
+     * @brief Set by withConnected()
+     */
+    bool connected = true;
+
+    /**
+     * @brief true if a request was made and the response has not been delivered
+     */
+    bool pending = false;
+};
+
+#if !DEVICENAMEHELPER_POSIX
+/**
+ * @brief Transport that requests the name over a serial port or other Stream
+ * 
+ * This is intended for a device connected to a gateway that has a cloud connection,
+ * or that knows the names itself. The request is the line "particle/device/name" (with
+ * a LF line ending) and the response is a line containing the name. A CR before the LF
+ * is ignored, and an empty line means there is no name. 
+ * 
+ * The stream is always considered to be connected and the time is not required, so the 
+ * name can be retrieved without a cloud connection.
+ */
+class DeviceNameHelperStreamTransport : public DeviceNameHelperTransport {
+public:
+    /**
+     * @brief Constructor
+     * 
+     * @param stream The stream, such as Serial1. You must call its begin() method to set
+     * the baud rate.
+     */
+    DeviceNameHelperStreamTransport(Stream &stream) : stream(stream) {};
+
+    /**
+     * @brief Discards any partial response
+     */
+    virtual void begin() { lineLen = 0; };
+
+    /**
+     * @brief Writes the request line
+     */
+    virtual int publishRequest();
+
+    /**
+     * @brief Reads the response from the stream
+     */
+    virtual void loop();
+
+    /**
+     * @brief Always returns true
+     */
+    virtual bool isConnected() const { return true; };
+
+    /**
+     * @brief There's no subscription, so there's no need to wait after connecting
+     */
+    virtual unsigned long getConnectWaitMs() const { return 0; };
+
+    /**
+     * @brief Returns false; the time is not needed to make a request
+     */
+    virtual bool requiresValidTime() const { return false; };
+
+protected:
+    /**
+     * @brief The stream passed to the constructor
+     */
+    Stream &stream;
+
+    /**
+     * @brief The response line being read. A longer line is truncated.
+     */
+    char line[DEVICENAMEHELPER_MAX_NAME_LEN * 2 + 1];
+
+    /**
+     * @brief Number of bytes in line
+     */
+    size_t lineLen = 0;
+};
+#endif /* !DEVICENAMEHELPER_POSIX */
+
 /**
  * @brief Generic base class used by all storage methods
  * 
@@ -72,12 +595,175 @@ public:
      * @brief Magic bytes used to detect if EEPROM or retained memory has been initialized
      */
     static const uint32_t DATA_MAGIC = 0x7787a2f2;
+
+    /**
+     * @brief Bit in DeviceNameHelperData flags set if the name was truncated
+     */
+    static const uint8_t FLAG_TRUNCATED = 0x01;
+
+    /**
+     * @brief Bit in DeviceNameHelperData flags set if the name is the fallback name, not from the cloud
+     */
+    static const uint8_t FLAG_PROVISIONAL = 0x02;
     
     /**
      * @brief You must call this from loop on every call to loop()
      */
     void loop();
 
+    /**
+     * @brief Result from waitForName()
+     */
+    enum class WaitResult {
+        SUCCESS,            //!< The name is available
+        NO_CONNECTION,      //!< Timed out, not connected to the cloud
+        NO_TIME,            //!< Timed out, connected but the time is not valid yet
+        BUDGET_EXCEEDED,    //!< Timed out, the request was delayed by withRequestBudget()
+        NO_RESPONSE,        //!< Timed out waiting for the response from the cloud
+        NOT_SETUP           //!< setup() has not been called
+    };
+
+    /**
+     * @brief Waits until the name is available, blocking, with a timeout
+     * 
+     * @param timeout How long to wait. You can use chrono literals such as 30s.
+     * 
+     * @return WaitResult::SUCCESS if the name is available, or the reason for timing out.
+     * 
+     * This calls loop() and Particle.process() while waiting, so the name can be retrieved
+     * and it returns as soon as it is. If the name is already known, it returns immediately.
+     * It's intended to be used from setup() instead of writing your own loop with delays.
+     * 
+     * Returns SUCCESS only for the real name, not the fallback name from withFallbackName().
+     */
+    WaitResult waitForName(std::chrono::milliseconds timeout);
+
+    /**
+     * @brief State identifiers recorded in the trace
+     */
+    enum class TraceState : uint8_t {
+        NONE,               //!< No state handler, done
+        START,              //!< stateStart
+        SUBSCRIBE,          //!< stateSubscribe
+        WAIT_CONNECTED,     //!< stateWaitConnected
+        WAIT_REQUEST,       //!< stateWaitRequest
+        WAIT_RESPONSE,      //!< stateWaitResponse
+        WAIT_RETRY,         //!< stateWaitRetry
+        WAIT_RECHECK,       //!< stateWaitRecheck
+        WAIT_SESSION        //!< stateWaitSession
+    };
+
+    /**
+     * @brief Reason for a state change recorded in the trace
+     */
+    enum class TraceReason : uint8_t {
+        SETUP,              //!< setup() was called
+        CHECK_NAME,         //!< checkName() was called
+        REQUEST_NAME,       //!< requestName() was called
+        SESSION_STARTING,   //!< sessionStarting() was called
+        CANCELLED,          //!< DeviceNameHelperRequest::cancel() was called
+        HAVE_NAME,          //!< The name is already known at startup
+        NEED_NAME,          //!< The name needs to be requested
+        SUBSCRIBED,         //!< The subscription was added, or already existed
+        CONNECTED,          //!< Connected and the time is valid
+        DISCONNECTED,       //!< The transport disconnected
+        REQUEST_SENT,       //!< The request was sent
+        SEND_FAILED,        //!< The transport could not send the request
+        GOT_NAME,           //!< The response contained the name
+        NO_NAME,            //!< The response did not contain a name
+        TIMEOUT,            //!< No response within RESPONSE_WAIT_MS
+        RETRY,              //!< The retry wait expired
+        RECHECK_DISABLED,   //!< No check period is set, so there's nothing more to do
+        RECHECK_DUE,        //!< It's time for the periodic check
+        DEFERRED            //!< The periodic check is waiting for sessionStarting()
+    };
+
+    /**
+     * @brief One state change in the trace
+     */
+    struct TraceEntry { // 8 bytes
+        /**
+         * @brief millis() value when the state changed
+         */
+        uint32_t        time;
+
+        /**
+         * @brief The previous state
+         */
+        TraceState      fromState;
+
+        /**
+         * @brief The new state
+         */
+        TraceState      toState;
+
+        /**
+         * @brief Why the state changed
+         */
+        TraceReason     reason;
+
+        /**
+         * @brief Reserved, currently 0
+         */
+        uint8_t         reserved;
+    };
+
+    /**
+     * @brief Records state changes in a ring buffer, for diagnosing why getting the name was slow
+     * 
+     * @param size Number of state changes to keep. Each uses 8 bytes. When the buffer is full, the 
+     * oldest entry is replaced. 0 turns off tracing, which is the default.
+     * 
+     * @return *this, so you can chain the withXXX() calls, fluent-style.
+     * 
+     * Recording a state change is a few stores, so it can be left on in production.
+     * A full request with no problems uses about 6 entries.
+     */
+    DeviceNameHelper &withTrace(size_t size);
+
+    /**
+     * @brief Returns the number of entries in the trace, up to the size passed to withTrace()
+     */
+    size_t getTraceCount() const { return traceCount; };
+
+    /**
+     * @brief Gets an entry from the trace
+     * 
+     * @param index 0 is the oldest entry, getTraceCount() - 1 is the newest
+     * 
+     * @param entry Filled in with the entry
+     * 
+     * @return true if index is valid
+     */
+    bool getTrace(size_t index, TraceEntry &entry) const;
+
+    /**
+     * @brief Removes all entries from the trace
+     */
+    void clearTrace() { traceNext = traceCount = 0; };
+
+    /**
+     * @brief Formats the trace as text, oldest first, one line per entry
+     * 
+     * @param fn Function called with each line, for example:
+     * 
+     * dumpTrace([](const char *line) { Log.info("%s", line); });
+     * 
+     * Each line contains the time, the state change, the reason, and how long was spent
+     * in the previous state if it's known.
+     */
+    void dumpTrace(std::function<void(const char *line)> fn) const;
+
+    /**
+     * @brief Returns the name of a state, such as "WAIT_CONNECTED"
+     */
+    static const char *getStateName(TraceState state);
+
+    /**
+     * @brief Returns the name of a reason, such as "TIMEOUT"
+     */
+    static const char *getReasonName(TraceReason reason);
+
     /**
      * @brief Adds a function to call when the name is known
      * 
@@ -94,36 +780,271 @@ public:
     DeviceNameHelper &withNameCallback(std::function<void(const char *)> nameCallback);
 
     /**
-     * @brief Sets 
-     * 
-     * @param checkPeriod How often to check. You can use chrono literals such as 24h for
-     * to check once a day, for example.
+     * @brief Adds a string that's formatted from the device name
+     * 
+     * @param nameFormat The DeviceNameHelperFormat object, typically a DeviceNameHelperFormatBuffer
+     * global variable. It must not be deleted after registering it.
+     * 
+     * @return *this, so you can chain the withXXX() calls, fluent-style.
+     * 
+     * The string is formatted now, and again each time the name changes. Use
+     * nameFormat.c_str() to get the formatted string. Registering the same object
+     * again has no effect.
+     */
+    DeviceNameHelper &withNameFormat(DeviceNameHelperFormat &nameFormat);
+
+    /**
+     * @brief Sets 
+     * 
+     * @param checkPeriod How often to check. You can use chrono literals such as 24h for
+     * to check once a day, for example.
+     * 
+     * @return *this, so you can chain the withXXX() calls, fluent-style.
+     * 
+     * The default is to check once. After the name has been retrieved it will not be retrieved again.
+     * This also means that if the name is ever changed, the change would not be detected.
+     * 
+     * The period is measured from the time of the last check (Time.now()), so it carries over
+     * a restart. With a transport that doesn't require a valid time, such as 
+     * DeviceNameHelperStreamTransport, the period is measured with millis() from the last check 
+     * or from setup() while the time is not valid. It then restarts with each boot and must be 
+     * less than 49 days.
+     */
+    DeviceNameHelper &withCheckPeriod(std::chrono::seconds checkPeriod) { this->checkPeriod = checkPeriod; return *this; };
+
+    /**
+     * @brief Limits the number of name requests in a rolling time window
+     * 
+     * @param maxRequests The maximum number of requests in window. 0 removes the limit, which
+     * is the default.
+     * 
+     * @param window The length of the window. You can use chrono literals such as 24h. It must
+     * be less than 49 days.
+     * 
+     * @return *this, so you can chain the withXXX() calls, fluent-style.
+     * 
+     * This protects your data operations quota if the check period is set too short, or if
+     * the name request keeps failing. When the limit is reached, the request is delayed until 
+     * the oldest request in the window is more than window old; it is never dropped. The
+     * number of times this happened is in getStats().throttledRequestCount.
+     */
+    DeviceNameHelper &withRequestBudget(size_t maxRequests, std::chrono::seconds window);
+
+    /**
+     * @brief Defer periodic rechecks until the application starts a cloud session
+     * 
+     * @param value true to defer rechecks (default), false to recheck on the next connection
+     * 
+     * @return *this, so you can chain the withXXX() calls, fluent-style.
+     * 
+     * This is intended for devices that connect briefly, for example to publish telemetry,
+     * and are otherwise disconnected. When the checkPeriod expires, the recheck waits until
+     * you call sessionStarting() instead of waiting for whatever connection happens next.
+     * The name request is then made as soon as the subscription is active in that session,
+     * so it completes inside the connection window you were already going to use.
+     * 
+     * This only affects periodic rechecks. If there is no saved name, or if you call 
+     * checkName(), the name is requested on the next connection as usual.
+     */
+    DeviceNameHelper &withDeferRecheckUntilSession(bool value = true) { this->deferRecheck = value; return *this; };
+
+    /**
+     * @brief Call before connecting to the cloud when using withDeferRecheckUntilSession()
+     * 
+     * If a recheck is waiting for a session, it's started now so the subscription is
+     * in place when the connection comes up. If no recheck is due, this does nothing,
+     * so it's safe to call before every connection.
+     */
+    void sessionStarting();
+
+    /**
+     * @brief Sets a name to use until the name has been retrieved from the cloud
+     * 
+     * @param fallbackName The name to use, or NULL (the default) to use the device ID. 
+     * The string is not copied so it must remain valid until setup() is called, such
+     * as a string literal or a name your code reads from its own storage. It's
+     * truncated to DEVICENAMEHELPER_MAX_NAME_LEN if necessary.
+     * 
+     * @return *this, so you can chain the withXXX() calls, fluent-style.
+     * 
+     * You must call this before setup(). If there is no saved name, getName() returns 
+     * the fallback name immediately after setup() instead of an empty string, so 
+     * you don't need to wait for the cloud connection to use a name. It's not saved,
+     * hasName() returns false, isNameProvisional() returns true, and the name callback
+     * is not called, until the real name is retrieved from the cloud.
+     */
+    DeviceNameHelper &withFallbackName(const char *fallbackName = NULL) { this->fallbackName = fallbackName; useFallbackName = true; return *this; };
+
+    /**
+     * @brief Sets the method used to request the name. Call before setup().
+     * 
+     * @param transport The transport, such as a DeviceNameHelperStreamTransport. It's not 
+     * copied and must remain valid, typically a global variable. The default is 
+     * DeviceNameHelperCloudTransport, which uses the "particle/device/name" event.
+     * 
+     * @return *this, so you can chain the withXXX() calls, fluent-style.
+     */
+    DeviceNameHelper &withTransport(DeviceNameHelperTransport &transport);
+
+    /**
+     * @brief Sets the seed for the random part of the retry wait
+     * 
+     * @param seed The seed. 0 uses the hardware random number generator, which is the default.
+     * 
+     * @return *this, so you can chain the withXXX() calls, fluent-style.
+     * 
+     * You normally don't need this. It's used by the fleet simulator so runs are repeatable.
+     */
+    DeviceNameHelper &withRandomSeed(uint32_t seed) { randomState = seed; return *this; };
+
+    /**
+     * @brief Returns true if the name has been retrived and is non-empty
+     * 
+     * This is false while the fallback name from withFallbackName() is being used.
+     */
+    bool hasName() const { return data && data->name[0] != 0 && (data->flags & FLAG_PROVISIONAL) == 0; };
+
+    /**
+     * @brief Returns true if getName() is returning the fallback name from withFallbackName()
+     */
+    bool isNameProvisional() const { return data && (data->flags & FLAG_PROVISIONAL) != 0; };
+
+    /**
+     * @brief Returns the device name as a c-string
+     * 
+     * May return an empty string if the name has not been retrieved yet, or the name
+     * from withFallbackName() if isNameProvisional() is true.
+     */
+    const char *getName() const { return data ? data->name : ""; };
+
+    /**
+     * @brief Returns the length of the device name in bytes, not including the null terminator
+     * 
+     * This is cached when the name changes, so it's faster than strlen(getName()).
+     */
+    size_t getNameLength() const { return nameLength; };
+
+    /**
+     * @brief Returns a 32-bit hash of the device name
+     * 
+     * This is computed once when the name changes using hashName(), so it's suitable
+     * for using as a key in frequently called code. The hash is stable across 
+     * restarts and devices (32-bit FNV-1a).
+     */
+    uint32_t getNameHash() const { return nameHash; };
+
+    /**
+     * @brief Hash a string the same way as getNameHash()
+     * 
+     * @param str The string to hash. Does not need to be null terminated.
+     * 
+     * @param len The length of str in bytes
+     * 
+     * Use this to compute the hash of names in your own tables so they can be 
+     * compared with getNameHash().
+     */
+    static uint32_t hashName(const char *str, size_t len);
+
+    /**
+     * @brief Copies a name into a DEVICENAMEHELPER_MAX_NAME_LEN + 1 byte buffer
+     * 
+     * @param src The name. It ends at a null byte or after srcLen bytes, whichever is first.
+     * NULL is treated as an empty string.
+     * 
+     * @param srcLen Maximum length of src. Use SIZE_MAX if it's null terminated.
+     * 
+     * @param dst Buffer of DEVICENAMEHELPER_MAX_NAME_LEN + 1 bytes. Always null terminated.
+     * 
+     * @param originalLength Filled in with the length of src in bytes
+     * 
+     * @return true if the name was truncated
+     * 
+     * The name is copied in a single pass, stopping at DEVICENAMEHELPER_MAX_NAME_LEN.
+     * If it's longer, the copy is backed off so it doesn't end in the middle of a 
+     * UTF-8 character.
+     */
+    static bool copyName(const char *src, size_t srcLen, char *dst, size_t &originalLength);
+
+    /**
+     * @brief Updates connection flags from a cloud_status or time_changed system event
+     * 
+     * Used by systemEventHandler() and DeviceNameHelperGateway::systemEventHandler(). 
+     * It only sets the flags, so it's safe to call from the system thread.
+     */
+    static void updateSystemFlags(system_event_t event, int param, volatile bool &cloudConnected, volatile bool &timeValid);
+
+    /**
+     * @brief Returns a number that increases every time the name changes
+     * 
+     * This is 0 before setup() is called. If you cache something derived from the
+     * name, such as a formatted string, save the generation when you build it and
+     * only rebuild it when the generation is different. This is a single atomic
+     * load, so it's much less expensive than comparing strings on every loop.
+     */
+    uint32_t getNameGeneration() const { return nameGeneration.load(std::memory_order_acquire); };
+
+    /**
+     * @brief Get the time the name was last fetched
+     * 
+     * Value is from from Time.now(), seconds past January 1, 1970, UTC. It's 0 if the name 
+     * was last fetched when the time was not valid, which is only possible with a transport
+     * that doesn't require a valid time.
+     */
+    long getLastNameCheckTime() const { return data ? data->lastCheck : 0; };
+
+    /**
+     * @brief Returns true if the name from the cloud was longer than DEVICENAMEHELPER_MAX_NAME_LEN
+     * 
+     * The name is truncated on a UTF-8 character boundary, so it may be a few bytes shorter 
+     * than DEVICENAMEHELPER_MAX_NAME_LEN if the name contains multi-byte characters.
+     */
+    bool isNameTruncated() const { return data && (data->flags & FLAG_TRUNCATED) != 0; };
+
+    /**
+     * @brief Returns the length of the name from the cloud in bytes, before truncation
+     */
+    size_t getOriginalNameLength() const { return data ? data->originalLength : 0; };
+
+    /**
+     * @brief Get the number of times the name has been requested from the cloud since startup
+     */
+    uint32_t getRequestCount() const { return stats.requestCount; };
+
+    /**
+     * @brief Get the number of requests that were abandoned because the cloud disconnected
+     * before the response arrived
+     * 
+     * These requests are made again when the cloud reconnects.
+     */
+    uint32_t getAbortedRequestCount() const { return stats.abortedRequestCount; };
+
+    /**
+     * @brief Get the number of requests that the transport could not send
      * 
-     * @return *this, so you can chain the withXXX() calls, fluent-style.
-     * 
-     * The default is to check once. After the name has been retrieved it will not be retrieved again.
-     * This also means that if the name is ever changed, the change would not be detected.
+     * These requests are made again after the retry wait.
      */
-    DeviceNameHelper &withCheckPeriod(std::chrono::seconds checkPeriod) { this->checkPeriod = checkPeriod; return *this; };
+    uint32_t getSendFailedCount() const { return stats.sendFailedCount; };
 
     /**
-     * @brief Returns true if the name has been retrived and is non-empty
+     * @brief Get the number of device name events that were ignored
+     * 
+     * These are duplicate responses, or responses that arrived after the request
+     * timed out or was aborted.
      */
-    bool hasName() const { return data && data->name[0] != 0; };
+    uint32_t getIgnoredResponseCount() const { return stats.ignoredResponseCount; };
 
     /**
-     * @brief Returns the device name as a c-string
+     * @brief Get the cloud usage caused by this library since startup or resetStats()
      * 
-     * May return an empty string if the name has not been retrieved yet
+     * You can use this to see the effect of different values of withCheckPeriod() on
+     * data operations and power usage.
      */
-    const char *getName() const { return data ? data->name : ""; };
+    const DeviceNameHelperStats &getStats() const { return stats; };
 
     /**
-     * @brief Get the time the name was last fetched
-     * 
-     * Value is from from Time.now(), seconds past January 1, 1970, UTC.
+     * @brief Clear all of the counters returned by getStats()
      */
-    long getLastNameCheckTime() const { return data ? data->lastCheck : 0; };
+    void resetStats() { stats = DeviceNameHelperStats(); };
 
     /**
      * @brief Request the name again 
@@ -133,6 +1054,20 @@ public:
      */
     void checkName();
 
+    /**
+     * @brief Request the name now, and return a handle to find out when it completes
+     * 
+     * @return A DeviceNameHelperRequest handle. Use its status() or isDone() methods to
+     * find out when the request completes and whether the name changed, and cancel()
+     * to cancel it.
+     * 
+     * Like checkName(), this requests the name even if it's known and it's not time to
+     * check. However, the request is started immediately instead of on the next periodic
+     * check, including if waiting to retry after a failure. If a request is already 
+     * pending, the same request is returned.
+     */
+    DeviceNameHelperRequest requestName();
+
     /**
      * @brief Call if you've called Particle.unsubscribe.
      * 
@@ -169,6 +1104,23 @@ public:
      */
     static DeviceNameHelper *getInstance() { return _instance; };
 
+#if DEVICENAMEHELPER_HAS_COROUTINES
+    /**
+     * @brief Returns an awaitable for use with co_await in a C++20 coroutine
+     * 
+     * @param timeout Maximum time to wait. The default, 0, waits until the name is available.
+     * 
+     * The result of co_await is true if the name is available or false on timeout, for example:
+     * 
+     * if (co_await DeviceNameHelperRetained::instance().awaitName(60s)) {
+     * 
+     * If the name is already known the coroutine does not suspend. Otherwise, it's resumed
+     * from loop() in the same call that the name is retrieved, or when the timeout expires.
+     * It's only available when compiling with coroutine support; see DEVICENAMEHELPER_HAS_COROUTINES.
+     */
+    DeviceNameHelperAwaiter awaitName(std::chrono::milliseconds timeout = 0ms);
+#endif
+
 protected:
     /**
      * @brief Constructor - You never instantiate this class directly.
@@ -195,6 +1147,12 @@ protected:
 
     /**
      * @brief All of the storage-method specific setup methods call that at the end
+     * 
+     * The data loaded by the storage method is discarded if the magic bytes or size 
+     * do not match, or if the name is not null terminated.
+     * 
+     * If there is no name and withFallbackName() was used, the fallback name is 
+     * set in data with FLAG_PROVISIONAL.
      */
     void commonSetup();
 
@@ -206,6 +1164,76 @@ protected:
      */
     virtual void save();
 
+    /**
+     * @brief Returns how long to wait before retrying, RETRY_WAIT_MS adjusted by a random 
+     * amount within RETRY_JITTER_MS
+     * 
+     * Uses a small per-instance generator (xorshift32) seeded by withRandomSeed() or the 
+     * hardware random number generator, so devices don't share the sequence from rand().
+     */
+    unsigned long getRetryWaitMs();
+
+    /**
+     * @brief Returns true if a request can be made without exceeding withRequestBudget()
+     */
+    bool budgetAvailable() const;
+
+    /**
+     * @brief Record that a request was made in budgetTimes
+     */
+    void budgetUsed();
+
+    /**
+     * @brief Subscribes to the response, calling subscriptionHandler
+     * 
+     * Called from stateSubscribe. The default calls begin() on the transport set with
+     * withTransport(). You can override this and publishRequest() to substitute a local 
+     * stand-in for the cloud, for example to test how the state machine handles
+     * delayed, dropped, or duplicate responses. The override must call 
+     * subscriptionHandler() when the response arrives.
+     */
+    virtual void addSubscription();
+
+    /**
+     * @brief Requests the name
+     * 
+     * Called from stateWaitRequest. The default calls publishRequest() on the transport
+     * and stores its result in requestBytes. See addSubscription().
+     */
+    virtual void publishRequest();
+
+    /**
+     * @brief Returns true if stateHandler is the specified state handler
+     */
+    bool isState(void (DeviceNameHelper::*state)()) const;
+
+    /**
+     * @brief Changes stateHandler, recording the change in the trace if withTrace() was used
+     * 
+     * @param state The new state handler, or NULL for the done state
+     * 
+     * @param reason Why the state is changing
+     */
+    void setState(void (DeviceNameHelper::*state)(), TraceReason reason);
+
+    /**
+     * @brief Returns the TraceState for a state handler
+     */
+    static TraceState getTraceState(void (DeviceNameHelper::*state)());
+
+    /**
+     * @brief Sets the result of the requestName() request if it's pending
+     */
+    void completeRequest(DeviceNameHelperRequest::Status status);
+
+    /**
+     * @brief Updates nameLength and nameHash from data->name, increments nameGeneration,
+     * and formats the nameFormats strings
+     * 
+     * Called from commonSetup() and whenever the name changes.
+     */
+    void updateNameCache();
+
     /**
      * @brief State handler, entry point when starting up.
      * 
@@ -214,12 +1242,13 @@ protected:
      * 
      * Next state:
      * stateWaitRecheck - If the device name is set
-     * stateSubscribe - If the device name needs to be retrieved
+     * stateSubscribe - If the device name needs to be retrieved, including if the fallback name is being 
+     * used or checkName() or requestName() was called before the first loop()
      */
     void stateStart();
 
     /**
-     * @brief Add a subscription handler, if necessary.
+     * @brief Calls the transport's begin() to add a subscription handler, if necessary.
      * 
      * Next state:
      * stateWaitConnected
@@ -227,7 +1256,12 @@ protected:
     void stateSubscribe();
 
     /**
-     * @brief Waits until Particle.connected() and Time.isValid() are true
+     * @brief Waits until the cloud is connected and the time is valid
+     * 
+     * This does not poll Particle.connected() and Time.isValid(). Instead, the
+     * cloudConnected and timeValid flags are updated by systemEventHandler() when
+     * the cloud_status and time_changed system events fire, so this state is
+     * just a check of two flags until then.
      * 
      * Next state:
      * stateWaitRequest
@@ -235,11 +1269,16 @@ protected:
     void stateWaitConnected();
 
     /**
-     * @brief Waits POST_CONNECT_WAIT_MS milliseconds (2 seconds) then
-     * publishes the request for device name event "particle/device/name"
+     * @brief Waits the transport's getConnectWaitMs() (POST_CONNECT_WAIT_MS, 2 seconds, for
+     * the cloud) then sends the request using the transport
+     * 
+     * If withRequestBudget() is used and the budget has been used up, the request is
+     * delayed until it's available again.
      * 
      * Next state:
      * stateWaitResponse
+     * stateWaitConnected - the cloud disconnected
+     * stateWaitRetry - the transport could not send the request
      */
     void stateWaitRequest();
 
@@ -252,11 +1291,12 @@ protected:
      * Next state:
      * stateWaitRecheck - name was found
      * stateWaitRetry - timeout (RESPONSE_WAIT_MS, 15 seconds) or empty name
+     * stateWaitConnected - the cloud disconnected, so the request is made again on reconnect
      */
     void stateWaitResponse();
 
     /**
-     * @brief Waits 5 minutes (RETRY_WAIT_MS) and tries requesting the name again
+     * @brief Waits about 5 minutes (getRetryWaitMs()) and tries requesting the name again
      * 
      * Next state:
      * stateWaitConnected
@@ -266,21 +1306,64 @@ protected:
     /**
      * @brief Wait until it's time to check the name again
      * 
+     * A forced check from checkName() starts on the next call. The time of the next
+     * periodic check is converted to a millis() deadline once the time is valid, so
+     * the check starts within a loop() call of being due without reading the
+     * clock on every loop.
+     * 
      * Next state:
      * stateSubscribe if it's time to check the name again
+     * stateWaitSession if it's time to check the name again and rechecks are deferred
      * NULL if we're done
      */
     void stateWaitRecheck();
 
     /**
-     * @brief Subscription handler for the "particle/device/name" event
+     * @brief Gets the number of seconds until the next periodic check, negative if it's overdue
+     * 
+     * @param remaining Filled in with the number of seconds
+     * 
+     * @return false if it's not known yet because the time is not valid
+     * 
+     * This uses lastCheck and Time.now() when the time is valid. If the transport doesn't 
+     * require a valid time, and the time is not valid or the last check was made without it,
+     * the period is counted with millis() from lastCheckMs instead.
+     */
+    bool getRecheckRemaining(long &remaining) const;
+
+    /**
+     * @brief A recheck is due but is waiting for sessionStarting() to be called
+     * 
+     * Only used with withDeferRecheckUntilSession().
+     * 
+     * Next state:
+     * stateSubscribe when sessionStarting() or checkName() is called
+     */
+    void stateWaitSession();
+
+    /**
+     * @brief Handles a response from the transport, such as the "particle/device/name" event
      * 
      * Since there's no way to unsubscribe a single subscription handler, it's 
      * never removed. See subscriptionRemoved() if you call Particle.unsubscribe()
      * from your code (which is rare).
+     * 
+     * Only the first response received after the request is sent in stateWaitRequest
+     * is used. It's stored in responseName, not data, and stateWaitResponse updates
+     * the data. All other events are counted in stats.ignoredResponseCount and discarded.
+     * The name is copied using copyName().
      */
     void subscriptionHandler(const char *eventName, const char *eventData);
 
+    /**
+     * @brief System event handler for cloud_status and time_changed events
+     * 
+     * System.on() only takes a plain function, so this is static and dispatches
+     * to the singleton instance. It may be called from the system thread, so it
+     * only updates the cloudConnected and timeValid flags.
+     */
+    static void systemEventHandler(system_event_t event, int param);
+
     /**
      * @brief Amount of time to wait after connection for the subscription to be activated (milliseconds)
      */
@@ -296,6 +1379,23 @@ protected:
      */
     static const unsigned long RETRY_WAIT_MS = 5 * 60 * 1000; // 5 minutes
 
+    /**
+     * @brief Range of the random adjustment to RETRY_WAIT_MS (in milliseconds)
+     * 
+     * The retry wait is between RETRY_WAIT_MS - RETRY_JITTER_MS / 2 and 
+     * RETRY_WAIT_MS + RETRY_JITTER_MS / 2, so the average is still RETRY_WAIT_MS. When 
+     * many devices fail to get a response at the same time, such as during a cloud
+     * outage, this keeps them from all retrying at the same time.
+     */
+    static const unsigned long RETRY_JITTER_MS = 60 * 1000; // 1 minute
+
+    /**
+     * @brief Longest millis() deadline used by stateWaitRecheck (in seconds)
+     * 
+     * Longer check periods are waited in steps of this length so millis() can't roll over.
+     */
+    static const unsigned long MAX_RECHECK_WAIT_S = 24 * 60 * 60; // 1 day
+
 protected:
     /**
      * @brief DeviceNameHelperData structure pointer
@@ -305,6 +1405,21 @@ protected:
      */
     DeviceNameHelperData *data = 0;
 
+    /**
+     * @brief Length of data->name, set by updateNameCache()
+     */
+    size_t nameLength = 0;
+
+    /**
+     * @brief Hash of data->name, set by updateNameCache()
+     */
+    uint32_t nameHash = 0;
+
+    /**
+     * @brief Incremented by updateNameCache(), returned by getNameGeneration()
+     */
+    std::atomic<uint32_t> nameGeneration{0};
+
     /**
      * @brief How often to fetch the name again in seconds (0 = never check again)
      */
@@ -318,10 +1433,25 @@ protected:
      */
     std::function<void(const char *)> nameCallback = 0;
 
+    /**
+     * @brief Name set using withFallbackName(), or NULL to use the device ID
+     */
+    const char *fallbackName = 0;
+
+    /**
+     * @brief true if withFallbackName() has been called
+     */
+    bool useFallbackName = false;
+
+    /**
+     * @brief Linked list of strings added using withNameFormat()
+     */
+    DeviceNameHelperFormat *nameFormats = 0;
+
     /**
      * @brief Current state handler, or NULL if in done state
      */
-    std::function<void(DeviceNameHelper&)> stateHandler = 0;
+    void (DeviceNameHelper::*stateHandler)() = 0;
 
     /**
      * @brief Some states use this for timing. It's a value from millis() if used.
@@ -329,25 +1459,276 @@ protected:
     unsigned long stateTime = 0;
 
     /**
-     * @brief true if Particle.subscribe has been called
+     * @brief How long to wait in stateWaitRetry, from getRetryWaitMs()
+     */
+    unsigned long retryWaitMs = RETRY_WAIT_MS;
+
+    /**
+     * @brief State of the random number generator used by getRetryWaitMs(), 0 if not seeded yet
+     */
+    uint32_t randomState = 0;
+
+    /**
+     * @brief Bytes sent by publishRequest(), or -1 if the request could not be sent
+     * 
+     * Set to 0 before each call, so an override that doesn't set it is treated as sent.
+     */
+    int requestBytes = 0;
+
+    /**
+     * @brief millis() value of the last check in this boot, or of setup() if there hasn't been one
+     * 
+     * Used by getRecheckRemaining() when the transport doesn't require a valid time.
+     */
+    unsigned long lastCheckMs = 0;
+
+    /**
+     * @brief How long to wait in stateWaitRecheck, valid if recheckScheduled is true
+     */
+    unsigned long recheckWaitMs = 0;
+
+    /**
+     * @brief true if stateWaitRecheck has calculated recheckWaitMs. Clear when entering stateWaitRecheck.
+     */
+    bool recheckScheduled = false;
+
+    /**
+     * @brief true if the transport's begin() has been called, which subscribes to the response
      */
     bool hasSubscribed = false;
 
     /**
-     * @brief true if the event subscription handler was called. The name is stored in data.name.
+     * @brief Default transport, using the "particle/device/name" event
+     */
+    DeviceNameHelperCloudTransport cloudTransport;
+
+    /**
+     * @brief Transport used to request the name, set by withTransport()
+     */
+    DeviceNameHelperTransport *transport = &cloudTransport;
+
+    /**
+     * @brief true if System.on() has been called to register systemEventHandler
+     */
+    bool hasSystemEvents = false;
+
+    /**
+     * @brief true if the cloud is connected, updated from the cloud_status system event
+     */
+    volatile bool cloudConnected = false;
+
+    /**
+     * @brief true if the time is valid, updated from the time_changed system event
+     */
+    volatile bool timeValid = false;
+
+    /**
+     * @brief true if the event subscription handler was called. The name is stored in responseName.
      */
     bool gotResponse = false;
+
+    /**
+     * @brief true if a request has been published and the response has not been received yet
+     * 
+     * Cleared when a response is received, or on timeout or disconnect, so late and
+     * duplicate responses are ignored.
+     */
+    bool awaitingResponse = false;
+
+    /**
+     * @brief The name from the response, used by stateWaitResponse when gotResponse is true
+     */
+    char responseName[DEVICENAMEHELPER_MAX_NAME_LEN + 1];
+
+    /**
+     * @brief Length of the name in the response before truncation
+     */
+    uint16_t responseOriginalLength = 0;
+
+    /**
+     * @brief true if responseName was truncated
+     */
+    bool responseTruncated = false;
     
     /**
      * @brief Used by checkName() to force the name to be checked again
      */
     bool forceCheck = false;
 
+    /**
+     * @brief Sequence number of the most recent requestName() request
+     */
+    uint32_t requestId = 0;
+
+    /**
+     * @brief Status of the most recent requestName() request
+     */
+    DeviceNameHelperRequest::Status requestStatus = DeviceNameHelperRequest::Status::FAILED;
+
+    /**
+     * @brief true if the most recent requestName() started a check, rather than joining a 
+     * periodic check or checkName() check already in progress. Only then does cancel() stop it.
+     */
+    bool requestStartedCheck = false;
+
+    /**
+     * @brief Counters returned by getStats()
+     */
+    DeviceNameHelperStats stats;
+
+    /**
+     * @brief Maximum number of requests in budgetWindowMs, or 0 for no limit
+     */
+    size_t budgetMax = 0;
+
+    /**
+     * @brief Length of the request budget window in milliseconds
+     */
+    unsigned long budgetWindowMs = 0;
+
+    /**
+     * @brief Ring buffer of the millis() values of the last budgetMax requests
+     */
+    std::vector<unsigned long> budgetTimes;
+
+    /**
+     * @brief Index in budgetTimes of the oldest request, which is where the next one goes
+     */
+    size_t budgetNext = 0;
+
+    /**
+     * @brief Number of entries in budgetTimes that have been used, up to budgetMax
+     */
+    size_t budgetCount = 0;
+
+    /**
+     * @brief true if the current request has already been counted in stats.throttledRequestCount
+     */
+    bool budgetThrottled = false;
+
+    /**
+     * @brief Ring buffer of state changes, sized by withTrace()
+     */
+    std::vector<TraceEntry> trace;
+
+    /**
+     * @brief Index in trace where the next entry is stored
+     */
+    size_t traceNext = 0;
+
+    /**
+     * @brief Number of valid entries in trace
+     */
+    size_t traceCount = 0;
+
+    /**
+     * @brief Set by withDeferRecheckUntilSession() to wait for sessionStarting() before rechecking
+     */
+    bool deferRecheck = false;
+
+    /**
+     * @brief true when in stateWaitSession, used by sessionStarting()
+     */
+    bool waitingForSession = false;
+
     /**
      * @brief Singleton instance pointer, set by the subclass instance() methods.
      */
     static DeviceNameHelper *_instance;
+
+    friend class DeviceNameHelperRequest;
+    friend class DeviceNameHelperTransport;
+
+#if DEVICENAMEHELPER_HAS_COROUTINES
+    /**
+     * @brief Resumes the suspended coroutines in awaiters that have a name or have timed out
+     * 
+     * Called from loop() when there are awaiters.
+     */
+    void resumeAwaiters();
+
+    /**
+     * @brief Linked list of suspended awaitName() coroutines
+     */
+    DeviceNameHelperAwaiter *awaiters = 0;
+
+    /**
+     * @brief Awaiters not yet checked by resumeAwaiters(). This is a member, not a local, so
+     * an awaiter destroyed by a coroutine resumed from resumeAwaiters() can unlink itself.
+     */
+    DeviceNameHelperAwaiter *resumeList = 0;
+
+    friend class DeviceNameHelperAwaiter;
+#endif
+};
+
+#if DEVICENAMEHELPER_HAS_COROUTINES
+/**
+ * @brief Awaitable returned by DeviceNameHelper::awaitName()
+ * 
+ * You don't use this class directly; use co_await on the value returned by awaitName().
+ * While the coroutine is suspended this object is stored in the coroutine frame and
+ * linked into the DeviceNameHelper awaiters list, so no allocation is required.
+ */
+class DeviceNameHelperAwaiter {
+public:
+    /**
+     * @brief Constructor, used by DeviceNameHelper::awaitName()
+     */
+    DeviceNameHelperAwaiter(DeviceNameHelper &helper, std::chrono::milliseconds timeout) : helper(helper), timeoutMs((unsigned long) timeout.count()) {};
+
+    /**
+     * @brief Destructor. Removes this awaiter from the helper.
+     * 
+     * This happens if a suspended coroutine is destroyed without being resumed, so loop()
+     * does not resume a coroutine frame that no longer exists.
+     */
+    ~DeviceNameHelperAwaiter();
+
+    /**
+     * @brief Returns true if the name is already known so the coroutine does not need to suspend
+     */
+    bool await_ready() const { return helper.hasName(); };
+
+    /**
+     * @brief Adds this awaiter to the helper so loop() will resume the coroutine
+     */
+    void await_suspend(std::coroutine_handle<> handle);
+
+    /**
+     * @brief Result of co_await: true if the name is available, false on timeout
+     */
+    bool await_resume() const { return helper.hasName(); };
+
+protected:
+    /**
+     * @brief The helper being awaited
+     */
+    DeviceNameHelper &helper;
+
+    /**
+     * @brief Timeout in milliseconds, or 0 for no timeout
+     */
+    unsigned long timeoutMs;
+
+    /**
+     * @brief millis() value when the coroutine was suspended
+     */
+    unsigned long startMs = 0;
+
+    /**
+     * @brief The suspended coroutine
+     */
+    std::coroutine_handle<> handle;
+
+    /**
+     * @brief Next awaiter in DeviceNameHelper awaiters
+     */
+    DeviceNameHelperAwaiter *next = 0;
+
+    friend class DeviceNameHelper;
 };
+#endif /* DEVICENAMEHELPER_HAS_COROUTINES */
 
 /**
  * @brief Version of DeviceNameHelper that stores the name in volatile RAM
@@ -403,6 +1784,7 @@ protected:
     DeviceNameHelperData _data;
 };
 
+#if !DEVICENAMEHELPER_POSIX
 /**
  * @brief Version of DeviceNameHelper that stores the name in EEPROM emulation
  * 
@@ -471,6 +1853,7 @@ protected:
      */
     DeviceNameHelperData eepromData;
 };
+#endif /* !DEVICENAMEHELPER_POSIX */
 
 /**
  * @brief Version of DeviceNameHelper that stores the name in retained RAM.
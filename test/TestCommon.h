@@ -0,0 +1,49 @@
+#ifndef __TESTCOMMON_H
+#define __TESTCOMMON_H
+
+// Shared code for the host tests in this directory. The tests use the POSIX build of the
+// library with the simulated clock, so they're repeatable and run hours of simulated
+// time in milliseconds.
+
+#include "DeviceNameHelperRK.h"
+
+#include <stdio.h>
+
+/**
+ * @brief Number of failed CHECK()s
+ */
+static int testFailures = 0;
+
+/**
+ * @brief Reports a failure, with the file and line, if cond is false
+ */
+#define CHECK(cond) do { if (!(cond)) { printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); testFailures++; } } while(0)
+
+/**
+ * @brief Prints the result. Return this from main().
+ */
+static inline int testResult(const char *name) {
+    printf("%s: %s\n", name, testFailures ? "FAILED" : "passed");
+    return testFailures ? 1 : 0;
+}
+
+/**
+ * @brief DeviceNameHelperNoStorage that can be created and deleted by each test
+ *
+ * It's also made the instance, so it gets the system events from Particle.setConnected().
+ */
+class TestHelper : public DeviceNameHelperNoStorage {
+public:
+    TestHelper() { _instance = this; };
+    virtual ~TestHelper() { _instance = 0; };
+
+    using DeviceNameHelper::RESPONSE_WAIT_MS;
+    using DeviceNameHelper::RETRY_WAIT_MS;
+    using DeviceNameHelper::RETRY_JITTER_MS;
+
+    bool isWaitingForResponse() const { return isState(&TestHelper::stateWaitResponse); };
+    bool isWaitingForRetry() const { return isState(&TestHelper::stateWaitRetry); };
+    bool isWaitingForRecheck() const { return isState(&TestHelper::stateWaitRecheck); };
+};
+
+#endif /* __TESTCOMMON_H */
@@ -0,0 +1,142 @@
+// Benchmark for DeviceNameHelperGateway::getName() lookups in tables of 1,000 and 10,000
+// devices. Build with make bench, which also builds a version that uses read() instead
+// of mmap (bench_gateway_read).
+//
+// The table file is written directly in the DeviceNameHelperTable format, so building it
+// isn't part of the measurement. The lookups are half devices in the table and half not.
+// After the lookups, one device is added and save() is timed.
+
+#include "DeviceNameHelperGateway.h"
+
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+/**
+ * @brief The constructor of DeviceNameHelperGateway is protected because it's normally a singleton
+ */
+class BenchGateway : public DeviceNameHelperGateway {
+public:
+    using DeviceNameHelperGateway::save;
+};
+
+static uint64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @brief Returns device ID number n. Even numbers are in the table, odd ones are not.
+ */
+static std::string deviceId(uint32_t n) {
+    uint8_t id[DEVICENAMEHELPER_DEVICE_ID_BYTES] = {0};
+    uint32_t mixed = n * 2654435761u;
+    memcpy(&id[0], &mixed, sizeof(mixed));
+    memcpy(&id[8], &n, sizeof(n));
+
+    char hex[DEVICENAMEHELPER_DEVICE_ID_LEN + 1];
+    DeviceNameHelperTable::formatDeviceId(id, hex);
+    return hex;
+}
+
+/**
+ * @brief Writes a table with count devices, the even numbered IDs from deviceId()
+ */
+static void writeTable(const char *path, uint32_t count) {
+    std::vector<std::string> ids;
+    for(uint32_t ii = 0; ii < count; ii++) {
+        ids.push_back(deviceId(ii * 2));
+    }
+    std::sort(ids.begin(), ids.end());
+
+    std::string pool;
+    std::vector<DeviceNameHelperTableRecord> records;
+    for(const std::string &id : ids) {
+        std::string name = "device-" + id.substr(0, 8);
+        DeviceNameHelperTableRecord record = {1609459200, (uint32_t) pool.size(), (uint8_t) name.size(), {0}};
+        records.push_back(record);
+        pool += name;
+    }
+
+    DeviceNameHelperTableHeader header = {DeviceNameHelperTable::FILE_MAGIC, count, (uint32_t) pool.size()};
+    FILE *fp = fopen(path, "wb");
+    fwrite(&header, sizeof(header), 1, fp);
+    for(const std::string &id : ids) {
+        uint8_t bin[DEVICENAMEHELPER_DEVICE_ID_BYTES];
+        DeviceNameHelperTable::parseDeviceId(id.c_str(), bin);
+        fwrite(bin, sizeof(bin), 1, fp);
+    }
+    fwrite(records.data(), sizeof(DeviceNameHelperTableRecord), records.size(), fp);
+    fwrite(pool.data(), 1, pool.size(), fp);
+    fclose(fp);
+}
+
+static int bench(uint32_t count, uint32_t lookups) {
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/bench_gateway_%d", (int) getpid());
+    writeTable(path, count);
+    unlink((std::string(path) + ".log").c_str());
+
+    BenchGateway *gateway = new BenchGateway();
+    gateway->setup(path);
+    if (gateway->getDeviceCount() != count) {
+        printf("table has %u devices, expected %u\n", (unsigned) gateway->getDeviceCount(), (unsigned) count);
+        return 1;
+    }
+
+    std::vector<std::string> ids;
+    for(uint32_t ii = 0; ii < lookups; ii++) {
+        ids.push_back(deviceId((ii * 7919) % (count * 2)));
+    }
+
+    std::vector<uint32_t> times;
+    size_t found = 0;
+    uint64_t start = nowNs();
+    for(const std::string &id : ids) {
+        uint64_t lookupStart = nowNs();
+        if (gateway->getName(id.c_str())[0]) {
+            found++;
+        }
+        times.push_back((uint32_t)(nowNs() - lookupStart));
+    }
+    uint64_t total = nowNs() - start;
+
+    std::sort(times.begin(), times.end());
+    printf("%6u devices, %s: %7.0f ns/lookup, p50 %u ns, p99 %u ns, %u%% found\n",
+        (unsigned) count, DEVICENAMEHELPER_USE_MMAP ? "mmap" : "read",
+        (double) total / lookups, times[times.size() / 2], times[times.size() * 99 / 100],
+        (unsigned)(found * 100 / lookups));
+
+    // Merge a change into the table, which rewrites the whole file
+    std::string added = deviceId(1);
+    gateway->addDevice(added.c_str());
+    start = nowNs();
+    bool saved = gateway->save();
+    uint64_t saveNs = nowNs() - start;
+    std::string present = deviceId(2);
+    std::string presentName = "device-" + present.substr(0, 8);
+    if (!saved || gateway->getDeviceCount() != count + 1 || gateway->getName(added.c_str())[0] ||
+        presentName != gateway->getName(present.c_str())) {
+        printf("table is wrong after save\n");
+        return 1;
+    }
+    printf("%6u devices, %s: %7.2f ms/save\n", (unsigned) count + 1,
+        DEVICENAMEHELPER_USE_MMAP ? "mmap" : "read", (double) saveNs / 1000000);
+
+    delete gateway;
+    unlink(path);
+    unlink((std::string(path) + ".log").c_str());
+    return 0;
+}
+
+int main() {
+    if (bench(1000, 100000) || bench(10000, 100000)) {
+        return 1;
+    }
+    return 0;
+}
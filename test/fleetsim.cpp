@@ -0,0 +1,319 @@
+// Fleet simulator for DeviceNameHelper. Runs natively on Linux; it's not for Particle devices.
+//
+// Build and run from this directory:
+// make sim
+// ./build/fleetsim -n 10000 -d 86400 -o 3000 -O 1800
+//
+// That runs a day with a 30 minute outage that starts 50 minutes after boot, so the hourly
+// checks are due during the outage. By default, the fleet boots into a 10 minute outage.
+//
+// Each simulated device is its own DeviceNameHelperNoStorage state machine, using the real
+// library code. The clock is simulated (Time.withSimulatedClock()), so a day of a 10,000
+// device fleet runs in seconds, and the run is repeatable for a given seed. The devices
+// share a simulated cloud with configurable latency, loss, and an outage.
+//
+// The output is the number of requests and responses per report interval, followed by the
+// time-to-name and request latency percentiles.
+
+#include "DeviceNameHelperRK.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <queue>
+
+class SimCloud;
+
+/**
+ * @brief Event name used to count bytes sent and received, like the cloud transport
+ */
+static const char *SIM_EVENT_NAME = "particle/device/name";
+
+/**
+ * @brief Simple repeatable random number generator (xorshift32)
+ */
+class SimRandom {
+public:
+    SimRandom(uint32_t seed) : state(seed ? seed : 1) {};
+
+    uint32_t next() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    };
+
+    /**
+     * @brief Returns a number from 0 to range - 1, or 0 if range is 0
+     */
+    unsigned long below(unsigned long range) { return range ? next() % range : 0; };
+
+protected:
+    uint32_t state;
+};
+
+/**
+ * @brief Transport that sends the request through the simulated cloud
+ */
+class SimTransport : public DeviceNameHelperTransport {
+public:
+    SimTransport(SimCloud &cloud, size_t index) : cloud(cloud), index(index) {};
+
+    virtual void begin() {};
+    virtual int publishRequest();
+    virtual bool isConnected() const;
+    virtual bool requiresValidTime() const { return true; };
+    virtual bool usesDataOperations() const { return true; };
+
+    /**
+     * @brief Called by SimCloud when the response arrives
+     */
+    void deliver(const char *name) { nameReceived(SIM_EVENT_NAME, name); };
+
+protected:
+    SimCloud &cloud;
+    size_t index;
+};
+
+/**
+ * @brief A simulated device. The constructor of DeviceNameHelperNoStorage is protected
+ * because it's normally a singleton.
+ */
+class SimDevice : public DeviceNameHelperNoStorage {
+public:
+    SimDevice(SimCloud &cloud, size_t index) : transport(cloud, index) {};
+
+    SimTransport transport;
+    unsigned long bootMs = 0;
+    bool booted = false;
+};
+
+/**
+ * @brief Simulated cloud, delivering responses after a random latency unless lost
+ */
+class SimCloud {
+public:
+    SimCloud(uint32_t seed) : random(seed) {};
+
+    /**
+     * @brief Queues the response to a request from device index
+     */
+    void publish(size_t index) {
+        requests++;
+        if (random.below(10000) < lossPer10000) {
+            // Request lost
+            return;
+        }
+        unsigned long now = millis();
+        pending.push(Pending{now + latencyMs + random.below(latencyJitterMs + 1), now, index});
+    };
+
+    /**
+     * @brief Delivers the responses due before endMs. Responses in flight during an outage are lost.
+     * 
+     * The clock is advanced to the time of each response and the device's loop() is called 
+     * so it's processed then, not at the next tick.
+     */
+    void deliver(std::vector<SimDevice *> &devices, unsigned long endMs) {
+        while(!pending.empty() && pending.top().deliverMs < endMs) {
+            Pending p = pending.top();
+            pending.pop();
+
+            if (p.deliverMs > millis()) {
+                Time.advance(p.deliverMs - millis());
+            }
+            if (!connected || random.below(10000) < lossPer10000) {
+                continue;
+            }
+            char name[32];
+            snprintf(name, sizeof(name), "device-%lu", (unsigned long) p.index);
+            responses++;
+            latencies.push_back(millis() - p.publishMs);
+            devices[p.index]->transport.deliver(name);
+            devices[p.index]->loop();
+        }
+    };
+
+    struct Pending {
+        unsigned long deliverMs;
+        unsigned long publishMs;
+        size_t index;
+        bool operator<(const Pending &other) const { return deliverMs > other.deliverMs; };
+    };
+
+    SimRandom random;
+    std::priority_queue<Pending> pending;
+    bool connected = true;
+    unsigned long latencyMs = 500;
+    unsigned long latencyJitterMs = 1500;
+    unsigned long lossPer10000 = 100;
+    unsigned long requests = 0;
+    unsigned long responses = 0;
+    std::vector<unsigned long> latencies;
+};
+
+int SimTransport::publishRequest() {
+    cloud.publish(index);
+    return (int) strlen(SIM_EVENT_NAME);
+}
+
+bool SimTransport::isConnected() const {
+    return cloud.connected;
+}
+
+static void printPercentiles(const char *label, std::vector<unsigned long> &values, double scale, const char *units) {
+    if (values.empty()) {
+        printf("%s: none\n", label);
+        return;
+    }
+    std::sort(values.begin(), values.end());
+    const double pct[] = { 50, 90, 99, 99.9, 100 };
+    printf("%s (%s, %lu samples):", label, units, (unsigned long) values.size());
+    for(double p : pct) {
+        size_t ii = std::min(values.size() - 1, (size_t)(p / 100.0 * (values.size() - 1) + 0.5));
+        printf(" p%g=%.1f", p, values[ii] / scale);
+    }
+    printf("\n");
+}
+
+static void usage() {
+    printf("usage: fleetsim [options]\n"
+        "  -n devices       number of devices (10000)\n"
+        "  -d seconds       simulated duration (21600)\n"
+        "  -b seconds       devices boot at random times within this period (60)\n"
+        "  -t ms            loop() tick (1000)\n"
+        "  -l ms            cloud latency (500)\n"
+        "  -j ms            additional random latency, up to (1500)\n"
+        "  -p percent       request and response loss (1)\n"
+        "  -o seconds       outage start (0, while the fleet is booting)\n"
+        "  -O seconds       outage length, 0 for none (600)\n"
+        "  -r seconds       check period, 0 to never check again (3600)\n"
+        "  -i seconds       report interval (60)\n"
+        "  -s seed          random seed (1)\n");
+}
+
+int main(int argc, char *argv[]) {
+    size_t numDevices = 10000;
+    unsigned long durationS = 6 * 3600;
+    unsigned long bootSpreadS = 60;
+    unsigned long tickMs = 1000;
+    unsigned long latencyMs = 500;
+    unsigned long latencyJitterMs = 1500;
+    double lossPercent = 1;
+    unsigned long outageStartS = 0;
+    unsigned long outageLengthS = 600;
+    unsigned long checkPeriodS = 3600;
+    unsigned long reportS = 60;
+    uint32_t seed = 1;
+
+    for(int ii = 1; ii < argc; ii++) {
+        if (argv[ii][0] != '-' || ii + 1 >= argc) {
+            usage();
+            return 1;
+        }
+        const char *value = argv[++ii];
+        switch(argv[ii - 1][1]) {
+            case 'n': numDevices = strtoul(value, NULL, 0); break;
+            case 'd': durationS = strtoul(value, NULL, 0); break;
+            case 'b': bootSpreadS = strtoul(value, NULL, 0); break;
+            case 't': tickMs = std::max(1UL, strtoul(value, NULL, 0)); break;
+            case 'l': latencyMs = strtoul(value, NULL, 0); break;
+            case 'j': latencyJitterMs = strtoul(value, NULL, 0); break;
+            case 'p': lossPercent = atof(value); break;
+            case 'o': outageStartS = strtoul(value, NULL, 0); break;
+            case 'O': outageLengthS = strtoul(value, NULL, 0); break;
+            case 'r': checkPeriodS = strtoul(value, NULL, 0); break;
+            case 'i': reportS = std::max(1UL, strtoul(value, NULL, 0)); break;
+            case 's': seed = (uint32_t) strtoul(value, NULL, 0); break;
+            default: usage(); return 1;
+        }
+    }
+
+    Time.withSimulatedClock();
+
+    SimCloud cloud(seed);
+    cloud.latencyMs = latencyMs;
+    cloud.latencyJitterMs = latencyJitterMs;
+    cloud.lossPer10000 = (unsigned long)(lossPercent * 100);
+
+    SimRandom random(seed ^ 0x5bd1e995);
+    std::vector<SimDevice *> devices;
+    std::vector<unsigned long> timeToName;
+    std::vector<unsigned long> recoveryToName;
+    unsigned long outageEndMs = (outageStartS + outageLengthS) * 1000;
+
+    for(size_t ii = 0; ii < numDevices; ii++) {
+        SimDevice *device = new SimDevice(cloud, ii);
+        device->bootMs = random.below(bootSpreadS * 1000 + 1);
+        device->withTransport(device->transport)
+            .withRandomSeed(seed + (uint32_t) ii + 1)
+            .withCheckPeriod(std::chrono::seconds(checkPeriodS))
+            .withNameCallback([device, outageLengthS, outageEndMs, &timeToName, &recoveryToName](const char *name) {
+                // Only the first name is counted, rechecks also call the callback
+                if (device->bootMs != (unsigned long) -1) {
+                    unsigned long now = millis();
+                    timeToName.push_back(now - device->bootMs);
+                    if (outageLengthS && device->bootMs < outageEndMs && now >= outageEndMs) {
+                        recoveryToName.push_back(now - outageEndMs);
+                    }
+                    device->bootMs = (unsigned long) -1;
+                }
+            });
+        devices.push_back(device);
+    }
+
+    printf("# devices=%lu duration=%lus tick=%lums latency=%lu+%lums loss=%g%% outage=%lus+%lus checkPeriod=%lus seed=%lu\n",
+        (unsigned long) numDevices, durationS, tickMs, latencyMs, latencyJitterMs, lossPercent,
+        outageStartS, outageLengthS, checkPeriodS, (unsigned long) seed);
+    printf("time_s,requests,responses,named,connected\n");
+
+    unsigned long lastRequests = 0, lastResponses = 0, peakRequests = 0, peakTime = 0;
+    unsigned long nextReportMs = reportS * 1000;
+
+    for(unsigned long now = 0; now <= durationS * 1000; now += tickMs) {
+        cloud.connected = !(outageLengthS && now >= outageStartS * 1000 && now < outageEndMs);
+
+        for(SimDevice *device : devices) {
+            if (!device->booted) {
+                if (now < device->bootMs) {
+                    continue;
+                }
+                device->booted = true;
+                device->setup();
+            }
+            device->loop();
+        }
+
+        if (now >= nextReportMs) {
+            unsigned long requests = cloud.requests - lastRequests;
+            if (requests > peakRequests) {
+                peakRequests = requests;
+                peakTime = now / 1000;
+            }
+            printf("%lu,%lu,%lu,%lu,%d\n", now / 1000, requests, cloud.responses - lastResponses,
+                (unsigned long) timeToName.size(), cloud.connected);
+            lastRequests = cloud.requests;
+            lastResponses = cloud.responses;
+            nextReportMs += reportS * 1000;
+        }
+
+        // Responses arriving before the next tick
+        cloud.deliver(devices, now + tickMs);
+        Time.advance(now + tickMs - millis());
+    }
+
+    unsigned long dataOperations = 0;
+    for(SimDevice *device : devices) {
+        dataOperations += device->getStats().dataOperations;
+    }
+
+    printf("# requests=%lu responses=%lu dataOperations=%lu named=%lu/%lu peak=%lu requests/%lus at %lus\n",
+        cloud.requests, cloud.responses, dataOperations, (unsigned long) timeToName.size(),
+        (unsigned long) numDevices, peakRequests, reportS, peakTime);
+    printPercentiles("# time to name from boot", timeToName, 1000.0, "s");
+    if (outageLengthS) {
+        printPercentiles("# time to name after the outage", recoveryToName, 1000.0, "s");
+    }
+    printPercentiles("# request latency", cloud.latencies, 1.0, "ms");
+
+    return 0;
+}
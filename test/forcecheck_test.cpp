@@ -0,0 +1,129 @@
+// Tests that checkName() and an expired check period start a check right away, measured
+// in simulated time, instead of waiting for a periodic tick. Also tests that the check
+// period works without a valid time when the transport doesn't require one.
+
+#include "TestCommon.h"
+
+static DeviceNameHelperLoopbackTransport loopback("loopback-name");
+
+/**
+ * @brief Returns the last state change in the trace
+ */
+static DeviceNameHelper::TraceEntry lastTrace(TestHelper &helper) {
+    DeviceNameHelper::TraceEntry entry = {};
+    if (helper.getTraceCount() > 0) {
+        helper.getTrace(helper.getTraceCount() - 1, entry);
+    }
+    return entry;
+}
+
+/**
+ * @brief Calls loop() until the request count increases, without advancing the clock
+ */
+static bool loopUntilRequest(TestHelper &helper) {
+    uint32_t requestCount = helper.getStats().requestCount;
+    for(int ii = 0; ii < 100; ii++) {
+        helper.loop();
+        if (helper.getStats().requestCount != requestCount) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static TestHelper *startTest(std::chrono::seconds checkPeriod) {
+    TestHelper *helper = new TestHelper();
+    helper->withTransport(loopback)
+        .withCheckPeriod(checkPeriod)
+        .withTrace(16);
+    helper->setup();
+
+    // Get the name, then let it settle in stateWaitRecheck
+    for(int ii = 0; ii < 100 && !helper->hasName(); ii++) {
+        helper->loop();
+        Time.advance(1);
+    }
+    helper->loop();
+    return helper;
+}
+
+static void testCheckName() {
+    TestHelper *helper = startTest(std::chrono::hours(24));
+    CHECK(helper->hasName());
+    CHECK(helper->isWaitingForRecheck());
+
+    // An hour later, checkName() starts a check on the next loop()
+    Time.advance(3600 * 1000);
+    helper->loop();
+    CHECK(helper->isWaitingForRecheck());
+
+    unsigned long start = millis();
+    helper->checkName();
+    helper->loop();
+    DeviceNameHelper::TraceEntry entry = lastTrace(*helper);
+    CHECK(entry.reason == DeviceNameHelper::TraceReason::CHECK_NAME);
+    CHECK(entry.time == start);
+
+    // And the request is sent without any time passing
+    CHECK(loopUntilRequest(*helper));
+    CHECK(millis() - start < 1);
+    CHECK(helper->getStats().requestCount == 2);
+
+    delete helper;
+}
+
+static void testCheckPeriod() {
+    TestHelper *helper = startTest(std::chrono::seconds(60));
+    CHECK(helper->isWaitingForRecheck());
+
+    // The deadline is 60 seconds after the check was scheduled
+    unsigned long scheduled = millis();
+    for(int ii = 0; ii < 60 * 1000 - 1; ii++) {
+        Time.advance(1);
+        helper->loop();
+    }
+    CHECK(helper->getStats().requestCount == 1);
+    CHECK(helper->isWaitingForRecheck());
+
+    Time.advance(1);
+    helper->loop();
+    DeviceNameHelper::TraceEntry entry = lastTrace(*helper);
+    CHECK(entry.reason == DeviceNameHelper::TraceReason::RECHECK_DUE);
+    CHECK(entry.time - scheduled == 60 * 1000);
+
+    unsigned long due = millis();
+    CHECK(loopUntilRequest(*helper));
+    CHECK(millis() - due < 1);
+
+    delete helper;
+}
+
+static void testCheckPeriodWithoutTime() {
+    // The loopback transport doesn't require a valid time, so the period is counted with millis()
+    Time.withSimulatedClock(0);
+    TestHelper *helper = startTest(std::chrono::seconds(60));
+    CHECK(!Time.isValid());
+    CHECK(helper->hasName());
+    CHECK(helper->getLastNameCheckTime() == 0);
+    CHECK(helper->isWaitingForRecheck());
+
+    unsigned long start = millis();
+    while(helper->getStats().requestCount == 1 && millis() - start < 120 * 1000) {
+        Time.advance(100);
+        helper->loop();
+    }
+    CHECK(helper->getStats().requestCount == 2);
+    CHECK(millis() - start >= 60 * 1000 && millis() - start <= 61 * 1000);
+
+    delete helper;
+}
+
+int main() {
+    Time.withSimulatedClock();
+
+    testCheckName();
+    testCheckPeriod();
+    testCheckPeriodWithoutTime();
+
+    return testResult("forcecheck_test");
+}
@@ -0,0 +1,169 @@
+// Standalone driver for the fuzz targets, for compilers without libFuzzer (such as g++).
+// With clang, build the targets with -fsanitize=fuzzer instead and this file isn't used.
+//
+// With file arguments, runs each file through the target, like libFuzzer does to
+// reproduce a crash. Otherwise runs random inputs, built from random bytes and the tokens
+// in the -dict=file dictionary if there is one, for -runs=N iterations (default 100000)
+// from -seed=N. The dictionary is in libFuzzer's format, so the same file works with both.
+// Reports the slowest input and fails if it took over -max_ms=N (default 100) milliseconds,
+// so an input that takes unbounded time is caught.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+static double nowMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static uint32_t randomState = 1;
+
+static uint32_t nextRandom() {
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+static int readFile(const char *path, std::vector<uint8_t> &data) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        perror(path);
+        return 1;
+    }
+    uint8_t buf[4096];
+    size_t count;
+    while((count = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        data.insert(data.end(), buf, buf + count);
+    }
+    fclose(fp);
+    return 0;
+}
+
+/**
+ * @brief Reads a libFuzzer dictionary: one quoted token per line, optionally preceded by
+ * name=, with \\, \", and \xNN escapes. Lines starting with # are comments.
+ */
+static int readDict(const char *path, std::vector<std::string> &dict) {
+    std::vector<uint8_t> data;
+    if (readFile(path, data)) {
+        return 1;
+    }
+    std::string text(data.begin(), data.end());
+
+    size_t lineStart = 0;
+    while(lineStart < text.size()) {
+        size_t lineEnd = text.find('\n', lineStart);
+        if (lineEnd == std::string::npos) {
+            lineEnd = text.size();
+        }
+        std::string line = text.substr(lineStart, lineEnd - lineStart);
+        lineStart = lineEnd + 1;
+
+        size_t open = line.find('"');
+        size_t close = line.rfind('"');
+        if (line.empty() || line[0] == '#' || open == std::string::npos || close <= open) {
+            continue;
+        }
+        std::string token;
+        for(size_t ii = open + 1; ii < close; ii++) {
+            if (line[ii] == '\\' && ii + 3 < close && line[ii + 1] == 'x') {
+                token += (char) strtoul(line.substr(ii + 2, 2).c_str(), NULL, 16);
+                ii += 3;
+            }
+            else if (line[ii] == '\\' && ii + 1 < close) {
+                token += line[++ii];
+            }
+            else {
+                token += line[ii];
+            }
+        }
+        if (!token.empty()) {
+            dict.push_back(token);
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    unsigned long runs = 100000;
+    double maxMs = 100;
+    std::vector<const char *> files;
+    std::vector<std::string> dict;
+
+    for(int ii = 1; ii < argc; ii++) {
+        if (strncmp(argv[ii], "-runs=", 6) == 0) {
+            runs = strtoul(argv[ii] + 6, NULL, 0);
+        }
+        else if (strncmp(argv[ii], "-seed=", 6) == 0) {
+            randomState = (uint32_t) strtoul(argv[ii] + 6, NULL, 0) | 1;
+        }
+        else if (strncmp(argv[ii], "-max_ms=", 8) == 0) {
+            maxMs = atof(argv[ii] + 8);
+        }
+        else if (strncmp(argv[ii], "-dict=", 6) == 0) {
+            if (readDict(argv[ii] + 6, dict)) {
+                return 1;
+            }
+        }
+        else if (argv[ii][0] != '-') {
+            files.push_back(argv[ii]);
+        }
+    }
+
+
+    double slowest = 0;
+    unsigned long count = 0;
+    std::vector<uint8_t> input;
+
+    if (!files.empty()) {
+        for(const char *path : files) {
+            input.clear();
+            if (readFile(path, input)) {
+                return 1;
+            }
+            double start = nowMs();
+            LLVMFuzzerTestOneInput(input.data(), input.size());
+            slowest = std::max(slowest, nowMs() - start);
+            count++;
+        }
+    }
+    else {
+        for(; count < runs; count++) {
+            // Sizes are mostly small, sometimes up to 4 KB
+            size_t size = (nextRandom() % 8 == 0) ? nextRandom() % 4096 : nextRandom() % 256;
+            input.clear();
+            while(input.size() < size) {
+                if (!dict.empty() && nextRandom() % 2 == 0) {
+                    const std::string &token = dict[nextRandom() % dict.size()];
+                    input.insert(input.end(), token.begin(), token.end());
+                }
+                else {
+                    input.push_back((uint8_t) nextRandom());
+                }
+            }
+            input.resize(size);
+
+            double start = nowMs();
+            LLVMFuzzerTestOneInput(input.data(), input.size());
+            slowest = std::max(slowest, nowMs() - start);
+        }
+    }
+
+    printf("%s: %lu inputs, slowest %.3f ms\n", argv[0], count, slowest);
+    if (slowest > maxMs) {
+        printf("%s: slowest input exceeded %.0f ms\n", argv[0], maxMs);
+        return 1;
+    }
+    return 0;
+}
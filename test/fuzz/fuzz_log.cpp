@@ -0,0 +1,86 @@
+// Fuzz target for replaying the gateway change log: DeviceNameHelperGateway::readLog(),
+// and merging it into the table with compact(). The input is the log file contents.
+
+#include "DeviceNameHelperGateway.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define FUZZ_ASSERT(cond) do { if (!(cond)) { fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); abort(); } } while(0)
+
+class FuzzGateway : public DeviceNameHelperGateway {
+public:
+    using DeviceNameHelperGateway::compact;
+    using DeviceNameHelperGateway::LOG_MAGIC;
+
+    /**
+     * @brief Returns true if the device IDs in the table are sorted with no duplicates
+     */
+    bool isTableSorted() const {
+        uint8_t prev[DEVICENAMEHELPER_DEVICE_ID_BYTES], id[DEVICENAMEHELPER_DEVICE_ID_BYTES];
+        for(size_t ii = 0; ii < table.getCount(); ii++) {
+            if (!table.readId(ii, id) || (ii > 0 && memcmp(prev, id, sizeof(id)) >= 0)) {
+                return false;
+            }
+            memcpy(prev, id, sizeof(id));
+        }
+        return true;
+    };
+};
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    static char path[64];
+    static String logPath;
+    if (!path[0]) {
+        snprintf(path, sizeof(path), "/tmp/fuzz_log_%d", (int) getpid());
+        logPath = String(path) + ".log";
+    }
+    unlink(path);
+
+    // Random bytes rarely make a valid log, so the first byte selects whether to add a valid
+    // header, and whether to replace the device IDs in the entries with valid ones
+    std::vector<uint8_t> file;
+    if (size > 0 && (data[0] & 1)) {
+        DeviceNameHelperGatewayLogHeader header = {FuzzGateway::LOG_MAGIC, (uint16_t) sizeof(DeviceNameHelperGatewayEntry), 0};
+        file.insert(file.end(), (const uint8_t *) &header, (const uint8_t *) &header + sizeof(header));
+    }
+    if (size > 1) {
+        file.insert(file.end(), data + 1, data + size);
+    }
+    if (size > 0 && (data[0] & 2)) {
+        static const char *hexDigits = "0123456789abcdefABCDEF";
+        for(size_t offset = sizeof(DeviceNameHelperGatewayLogHeader); offset + sizeof(DeviceNameHelperGatewayEntry) <= file.size(); offset += sizeof(DeviceNameHelperGatewayEntry)) {
+            DeviceNameHelperGatewayEntry *entry = (DeviceNameHelperGatewayEntry *) &file[offset];
+            for(size_t ii = 0; ii < DEVICENAMEHELPER_DEVICE_ID_LEN; ii++) {
+                // Only a few distinct IDs, so entries replace each other
+                entry->deviceId[ii] = (ii < 22) ? '0' : hexDigits[(uint8_t) entry->deviceId[ii] % 22];
+            }
+            entry->deviceId[DEVICENAMEHELPER_DEVICE_ID_LEN] = 0;
+            entry->name[(uint8_t) entry->name[0] % sizeof(entry->name)] = 0;
+        }
+    }
+
+    FILE *fp = fopen(logPath.c_str(), "wb");
+    FUZZ_ASSERT(fp != NULL);
+    FUZZ_ASSERT(file.empty() || fwrite(file.data(), 1, file.size(), fp) == file.size());
+    fclose(fp);
+
+    FuzzGateway *gateway = new FuzzGateway();
+    gateway->setup(path);
+    size_t count = gateway->getDeviceCount();
+    FUZZ_ASSERT(count <= file.size() / sizeof(DeviceNameHelperGatewayEntry));
+
+    // Merging the log into the table doesn't change the devices
+    gateway->compact();
+    FUZZ_ASSERT(gateway->getDeviceCount() == count);
+    delete gateway;
+
+    // And they're all still there after reading the new table
+    gateway = new FuzzGateway();
+    gateway->setup(path);
+    FUZZ_ASSERT(gateway->getDeviceCount() == count);
+    FUZZ_ASSERT(gateway->isTableSorted());
+    delete gateway;
+    return 0;
+}
@@ -0,0 +1,97 @@
+// Fuzz target for loading saved data: DeviceNameHelperFile::setup() and
+// DeviceNameHelperRetained::setup(), which both validate it in commonSetup(). The input is
+// the file or retained memory contents.
+
+#include "DeviceNameHelperRK.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <string>
+
+#define FUZZ_ASSERT(cond) do { if (!(cond)) { fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); abort(); } } while(0)
+
+class FuzzFileHelper : public DeviceNameHelperFile {
+public:
+};
+
+class FuzzRetainedHelper : public DeviceNameHelperRetained {
+public:
+};
+
+static DeviceNameHelperFormatBuffer<64> topic("fleet/%s/telemetry");
+
+/**
+ * @brief Fallback name longer than DEVICENAMEHELPER_MAX_NAME_LEN, made of 2-byte UTF-8 characters
+ */
+static std::string longFallback;
+
+static void checkName(DeviceNameHelper &helper) {
+    const char *name = helper.getName();
+    FUZZ_ASSERT(strlen(name) <= DEVICENAMEHELPER_MAX_NAME_LEN);
+    FUZZ_ASSERT(strlen(topic.c_str()) < 64);
+    if (!name[0]) {
+        FUZZ_ASSERT(!helper.hasName());
+    }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    static char path[64];
+    if (!path[0]) {
+        snprintf(path, sizeof(path), "/tmp/fuzz_setup_%d", (int) getpid());
+    }
+
+    // Random bytes rarely have the right magic bytes and size, so the first byte selects
+    // whether to fix them up to test the rest of the validation
+    DeviceNameHelperData saved;
+    memset(&saved, 0, sizeof(saved));
+    if (size > 1) {
+        memcpy(&saved, data + 1, std::min(size - 1, sizeof(saved)));
+        if (data[0] & 1) {
+            saved.magic = DeviceNameHelper::DATA_MAGIC;
+            saved.size = sizeof(DeviceNameHelperData);
+        }
+    }
+
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    FUZZ_ASSERT(fd != -1);
+    size_t fileSize = (size > 1 && (data[0] & 2)) ? size - 1 : sizeof(saved);
+    FUZZ_ASSERT(write(fd, (fileSize == sizeof(saved)) ? (const uint8_t *) &saved : data + 1, fileSize) == (ssize_t) fileSize);
+    close(fd);
+
+    {
+        FuzzFileHelper helper;
+        helper.withNameFormat(topic);
+        helper.setup(path);
+        checkName(helper);
+    }
+
+    {
+        FuzzRetainedHelper helper;
+        if (size > 0 && (data[0] & 4)) {
+            helper.withFallbackName("fallback");
+        }
+        else if (size > 0 && (data[0] & 8)) {
+            if (longFallback.empty()) {
+                for(size_t ii = 0; ii < DEVICENAMEHELPER_MAX_NAME_LEN; ii++) {
+                    longFallback += "\xc3\xa9";
+                }
+            }
+            helper.withFallbackName(longFallback.c_str());
+        }
+        // Same validation as commonSetup(); if the saved name isn't used, the fallback is
+        bool savedValid = saved.magic == DeviceNameHelper::DATA_MAGIC && saved.size == sizeof(DeviceNameHelperData) &&
+            memchr(saved.name, 0, sizeof(saved.name)) != NULL && saved.name[0];
+
+        helper.withNameFormat(topic);
+        helper.setup(&saved);
+        checkName(helper);
+        if (!savedValid && !longFallback.empty() && (data[0] & 0xc) == 8) {
+            // Truncated without splitting a character
+            FUZZ_ASSERT(strlen(helper.getName()) % 2 == 0);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,102 @@
+// Fuzz target for the name responses: DeviceNameHelper::subscriptionHandler() and copyName(),
+// and the DeviceNameHelperGateway response parser. The input is the event data. The 
+// dictionary is fuzz_subscription.dict.
+
+#include "DeviceNameHelperGateway.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#define FUZZ_ASSERT(cond) do { if (!(cond)) { fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); abort(); } } while(0)
+
+/**
+ * @brief Delivers a response as if the request had just been sent
+ */
+class FuzzHelper : public DeviceNameHelperNoStorage {
+public:
+    void deliver(const char *eventData) {
+        awaitingResponse = true;
+        setState(&FuzzHelper::stateWaitResponse, TraceReason::REQUEST_SENT);
+        stateTime = millis();
+
+        subscriptionHandler("particle/device/name", eventData);
+        loop();
+    };
+};
+
+/**
+ * @brief Delivers a gateway response as if the request for requestIds had just been sent
+ */
+class FuzzGateway : public DeviceNameHelperGateway {
+public:
+    void deliver(const char *requestIds, const char *eventData) {
+        requestData = requestIds;
+        awaitingResponse = true;
+        subscriptionHandler("hook-response/DeviceNameHelperGateway/0", eventData);
+        if (gotResponse) {
+            gotResponse = false;
+            processResponse();
+        }
+    };
+};
+
+static const char *deviceIds[] = {
+    "0123456789abcdef01234567",
+    "1123456789abcdef01234567",
+    "2123456789abcdef01234567",
+};
+
+static FuzzHelper *helper;
+static FuzzGateway *gateway;
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    if (!helper) {
+        static char path[64];
+        snprintf(path, sizeof(path), "/tmp/fuzz_subscription_%d", (int) getpid());
+        unlink(path);
+        unlink((String(path) + ".log").c_str());
+
+        helper = new FuzzHelper();
+        helper->setup();
+
+        gateway = new FuzzGateway();
+        gateway->setup(path);
+        for(const char *deviceId : deviceIds) {
+            gateway->addDevice(deviceId);
+        }
+    }
+
+    // copyName() with a buffer that isn't null terminated, so reading past srcLen is caught
+    std::vector<char> src(data, data + size);
+    char name[DEVICENAMEHELPER_MAX_NAME_LEN + 1];
+    size_t originalLength;
+    bool truncated = DeviceNameHelper::copyName(src.data(), src.size(), name, originalLength);
+    size_t nameLen = strlen(name);
+    FUZZ_ASSERT(nameLen <= DEVICENAMEHELPER_MAX_NAME_LEN);
+    FUZZ_ASSERT(nameLen == 0 || memcmp(name, src.data(), nameLen) == 0);
+    FUZZ_ASSERT(originalLength == (size ? strnlen(src.data(), size) : 0));
+    FUZZ_ASSERT(truncated == (originalLength > DEVICENAMEHELPER_MAX_NAME_LEN));
+
+    // The event data is null terminated
+    std::string eventData((const char *) data, size);
+    std::string previousName = helper->getName();
+    helper->deliver(eventData.c_str());
+    const char *helperName = helper->getName();
+    FUZZ_ASSERT(strlen(helperName) <= DEVICENAMEHELPER_MAX_NAME_LEN);
+    if (previousName != helperName) {
+        // A response that's empty, or empty after removing a partial UTF-8 character, keeps
+        // the previous name. Otherwise the name is the start of the response.
+        FUZZ_ASSERT(strncmp(helperName, eventData.c_str(), strlen(helperName)) == 0);
+    }
+
+    gateway->deliver("0123456789abcdef01234567,1123456789abcdef01234567,2123456789abcdef01234567", eventData.c_str());
+    for(const char *deviceId : deviceIds) {
+        FUZZ_ASSERT(strlen(gateway->getName(deviceId)) <= DEVICENAMEHELPER_MAX_NAME_LEN);
+    }
+    FUZZ_ASSERT(gateway->getDeviceCount() == sizeof(deviceIds) / sizeof(deviceIds[0]));
+    return 0;
+}
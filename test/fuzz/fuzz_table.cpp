@@ -0,0 +1,65 @@
+// Fuzz target for reading a table file: DeviceNameHelperTable::open(), find(), and
+// readEntry(). The input is the file contents.
+
+#include "DeviceNameHelperGateway.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define FUZZ_ASSERT(cond) do { if (!(cond)) { fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); abort(); } } while(0)
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    static char path[64];
+    if (!path[0]) {
+        snprintf(path, sizeof(path), "/tmp/fuzz_table_%d", (int) getpid());
+    }
+
+    // Random bytes rarely have a valid header, so the first byte selects whether to fix
+    // up the magic bytes and the pool size so the file size matches the count
+    std::vector<uint8_t> file(data + (size ? 1 : 0), data + size);
+    if (size > 0 && (data[0] & 1) && file.size() >= sizeof(DeviceNameHelperTableHeader)) {
+        DeviceNameHelperTableHeader header;
+        memcpy(&header, file.data(), sizeof(header));
+        header.magic = DeviceNameHelperTable::FILE_MAGIC;
+        header.count %= 64;
+        if (DeviceNameHelperTable::poolOffset(header.count) > file.size()) {
+            file.resize(DeviceNameHelperTable::poolOffset(header.count));
+        }
+        header.poolSize = (uint32_t)(file.size() - DeviceNameHelperTable::poolOffset(header.count));
+        memcpy(file.data(), &header, sizeof(header));
+    }
+
+    FILE *fp = fopen(path, "wb");
+    FUZZ_ASSERT(fp != NULL);
+    FUZZ_ASSERT(file.empty() || fwrite(file.data(), 1, file.size(), fp) == file.size());
+    fclose(fp);
+
+    DeviceNameHelperTable table;
+    if (!table.open(path)) {
+        FUZZ_ASSERT(table.getCount() == 0);
+        return 0;
+    }
+
+    for(size_t ii = 0; ii < table.getCount() && ii < 256; ii++) {
+        DeviceNameHelperGatewayEntry entry;
+        table.readEntry(ii, entry);
+        FUZZ_ASSERT(strlen(entry.deviceId) == 0 || strlen(entry.deviceId) == DEVICENAMEHELPER_DEVICE_ID_LEN);
+        FUZZ_ASSERT(strlen(entry.name) <= DEVICENAMEHELPER_MAX_NAME_LEN);
+
+        // The IDs may not be sorted, but find() must still stay within the table
+        uint8_t id[DEVICENAMEHELPER_DEVICE_ID_BYTES];
+        size_t index;
+        if (table.readId(ii, id)) {
+            table.find(id, index);
+            FUZZ_ASSERT(index <= table.getCount());
+        }
+    }
+
+    uint8_t id[DEVICENAMEHELPER_DEVICE_ID_BYTES];
+    memset(id, 0xff, sizeof(id));
+    size_t index;
+    FUZZ_ASSERT(!table.find(id, index) || index < table.getCount());
+    FUZZ_ASSERT(index <= table.getCount());
+    return 0;
+}
@@ -0,0 +1,228 @@
+// Tests for the DeviceNameHelperGateway change log, compaction, and request handling, using
+// a table file in /tmp and the simulated clock.
+
+#include "TestCommon.h"
+#include "DeviceNameHelperGateway.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief DeviceNameHelperGateway that can be created and deleted by each test
+ *
+ * The destructor removes the subscription, which calls this object.
+ */
+class TestGateway : public DeviceNameHelperGateway {
+public:
+    TestGateway() { _instance = this; };
+    virtual ~TestGateway() { _instance = 0; Particle.unsubscribe(); };
+
+    using DeviceNameHelperGateway::changes;
+    using DeviceNameHelperGateway::logRecords;
+    using DeviceNameHelperGateway::save;
+    using DeviceNameHelperGateway::compact;
+    using DeviceNameHelperGateway::needsCompact;
+    using DeviceNameHelperGateway::updateChange;
+    using DeviceNameHelperGateway::COMPACT_TABLE_DIVISOR;
+    using DeviceNameHelperGateway::RETRY_WAIT_MS;
+};
+
+static char tablePath[64];
+
+/**
+ * @brief Returns a device ID ending in n
+ */
+static std::string deviceId(int n) {
+    char id[DEVICENAMEHELPER_DEVICE_ID_LEN + 1];
+    snprintf(id, sizeof(id), "0123456789abcdef%08x", n);
+    return id;
+}
+
+/**
+ * @brief Removes the table, its log, and the temporary file used by save()
+ */
+static void removeFiles() {
+    unlink(tablePath);
+    unlink((std::string(tablePath) + ".log").c_str());
+    unlink((std::string(tablePath) + ".tmp").c_str());
+}
+
+static off_t logSize() {
+    struct stat st;
+    if (stat((std::string(tablePath) + ".log").c_str(), &st) != 0) {
+        return -1;
+    }
+    return st.st_size;
+}
+
+static void testLogTruncated() {
+    removeFiles();
+
+    TestGateway *gateway = new TestGateway();
+    gateway->setup(tablePath);
+    gateway->addDevice(deviceId(1).c_str());
+    gateway->addDevice(deviceId(2).c_str());
+    gateway->addDevice(deviceId(3).c_str());
+    delete gateway;
+
+    // Corrupt the second entry
+    off_t secondEntry = sizeof(DeviceNameHelperGatewayLogHeader) + sizeof(DeviceNameHelperGatewayEntry);
+    int fd = open((std::string(tablePath) + ".log").c_str(), O_WRONLY);
+    CHECK(fd != -1);
+    CHECK(pwrite(fd, "xx", 2, secondEntry) == 2);
+    close(fd);
+
+    gateway = new TestGateway();
+    gateway->setup(tablePath);
+    CHECK(gateway->getDeviceCount() == 1);
+    CHECK(logSize() == secondEntry);
+
+    // The entry after the corrupted one was discarded, so it isn't replayed after the new one
+    gateway->addDevice(deviceId(4).c_str());
+    delete gateway;
+
+    gateway = new TestGateway();
+    gateway->setup(tablePath);
+    CHECK(gateway->getDeviceCount() == 2);
+    CHECK(gateway->logRecords == 2);
+    delete gateway;
+}
+
+static void testCheckNotLogged() {
+    removeFiles();
+
+    TestGateway *gateway = new TestGateway();
+    gateway->withEventName("gatewayTest").withCheckPeriod(std::chrono::hours(1));
+    gateway->setup(tablePath);
+    for(int ii = 0; ii < 8; ii++) {
+        gateway->addDevice(deviceId(ii).c_str());
+    }
+    gateway->compact();
+    CHECK(gateway->logRecords == 0);
+
+    // Answer each request with the same name for each device
+    int requestCount = 0;
+    Particle.withPublishHandler([&requestCount](const char *eventName, const char *eventData) {
+        requestCount++;
+        String response;
+        for(int ii = 0; ii < 8; ii++) {
+            if (ii) {
+                response += ",";
+            }
+            response += deviceId(ii).c_str();
+            response += "=same-name";
+        }
+        Particle.receive("hook-response/gatewayTest", response.c_str());
+        return true;
+    });
+
+    for(int ii = 0; ii < 100; ii++) {
+        gateway->loop();
+        Time.advance(100);
+    }
+    CHECK(requestCount == 1);
+    CHECK(gateway->logRecords == 8);
+    CHECK(strcmp(gateway->getName(deviceId(3).c_str()), "same-name") == 0);
+    gateway->compact();
+
+    // An hour later the names are checked again. Nothing changed, so nothing is logged.
+    Time.advance(3600 * 1000);
+    for(int ii = 0; ii < 100; ii++) {
+        gateway->loop();
+        Time.advance(100);
+    }
+    CHECK(requestCount == 2);
+    CHECK(gateway->logRecords == 0);
+    CHECK(gateway->changes.size() == 8);
+
+    // But the check is kept, so the devices are not requested again
+    for(int ii = 0; ii < 100; ii++) {
+        gateway->loop();
+        Time.advance(100);
+    }
+    CHECK(requestCount == 2);
+
+    Particle.withPublishHandler(NULL);
+    delete gateway;
+}
+
+static void testPublishFails() {
+    removeFiles();
+
+    TestGateway *gateway = new TestGateway();
+    gateway->withEventName("gatewayTest");
+    gateway->setup(tablePath);
+    gateway->addDevice(deviceId(1).c_str());
+
+    std::vector<unsigned long> publishTimes;
+    Particle.withPublishHandler([&publishTimes](const char *eventName, const char *eventData) {
+        publishTimes.push_back(millis());
+        if (publishTimes.size() == 1) {
+            return false;
+        }
+        Particle.receive("hook-response/gatewayTest", (deviceId(1) + "=retried").c_str());
+        return true;
+    });
+
+    // The failed publish goes straight to the retry wait, not the 15 second response wait
+    unsigned long start = millis();
+    while(strcmp(gateway->getName(deviceId(1).c_str()), "retried") != 0 && millis() - start < 10 * 60 * 1000) {
+        gateway->loop();
+        Time.advance(100);
+    }
+    CHECK(publishTimes.size() == 2);
+    if (publishTimes.size() == 2) {
+        unsigned long retryWait = publishTimes[1] - publishTimes[0];
+        CHECK(retryWait >= TestGateway::RETRY_WAIT_MS && retryWait < TestGateway::RETRY_WAIT_MS + 2000);
+    }
+
+    Particle.withPublishHandler(NULL);
+    delete gateway;
+}
+
+static void testCompactThreshold() {
+    removeFiles();
+
+    TestGateway *gateway = new TestGateway();
+    gateway->setup(tablePath);
+    for(int ii = 0; ii < 1000; ii++) {
+        DeviceNameHelperGatewayEntry entry = {};
+        snprintf(entry.deviceId, sizeof(entry.deviceId), "%s", deviceId(ii).c_str());
+        gateway->updateChange(entry);
+    }
+    CHECK(gateway->save());
+    CHECK(gateway->getDeviceCount() == 1000);
+
+    // A 1000 device table is compacted after 1000 / COMPACT_TABLE_DIVISOR changes, not COMPACT_CHANGES
+    for(int ii = 0; ii < (int)(1000 / TestGateway::COMPACT_TABLE_DIVISOR) - 1; ii++) {
+        DeviceNameHelperGatewayEntry entry = {};
+        snprintf(entry.deviceId, sizeof(entry.deviceId), "%s", deviceId(ii).c_str());
+        entry.lastCheck = 1;
+        gateway->updateChange(entry);
+    }
+    CHECK(!gateway->needsCompact());
+
+    DeviceNameHelperGatewayEntry entry = {};
+    snprintf(entry.deviceId, sizeof(entry.deviceId), "%s", deviceId(999).c_str());
+    gateway->updateChange(entry);
+    CHECK(gateway->needsCompact());
+
+    delete gateway;
+}
+
+int main() {
+    Time.withSimulatedClock();
+    Particle.setConnected(true);
+    snprintf(tablePath, sizeof(tablePath), "/tmp/gateway_test_%d", (int) getpid());
+
+    testLogTruncated();
+    testCheckNotLogged();
+    testPublishFails();
+    testCompactThreshold();
+
+    removeFiles();
+    return testResult("gateway_test");
+}
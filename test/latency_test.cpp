@@ -0,0 +1,311 @@
+// Round-trip tests for the name request, using a mock cloud in place of Particle.publish
+// and Particle.subscribe. The mock can delay, drop, duplicate, and reorder responses, so
+// stateWaitResponse and stateWaitRetry can be tested without a cloud connection.
+
+#include "TestCommon.h"
+
+#include <deque>
+
+/**
+ * @brief Stand-in for the cloud. Answers each particle/device/name request with "name-N",
+ * where N is the request number starting at 1.
+ */
+class MockCloud {
+public:
+    /**
+     * @brief What to do with a request
+     */
+    struct Behavior {
+        unsigned long delayMs;  //!< How long until the response arrives
+        int copies;             //!< Number of copies of the response, 0 to drop the request
+        bool hold;              //!< Hold the response until release() is called
+        bool fail = false;      //!< Particle.publish() returns false
+    };
+
+    void reset() {
+        behaviors.clear();
+        responses.clear();
+        publishTimes.clear();
+    };
+
+    /**
+     * @brief Publish handler: queues the response
+     */
+    bool publish(const char *eventName, const char *eventData) {
+        publishTimes.push_back(millis());
+
+        Behavior behavior = defaultBehavior;
+        if (!behaviors.empty()) {
+            behavior = behaviors.front();
+            behaviors.pop_front();
+        }
+        if (behavior.fail) {
+            return false;
+        }
+
+        char name[32];
+        snprintf(name, sizeof(name), "name-%u", (unsigned) publishTimes.size());
+        for(int ii = 0; ii < behavior.copies; ii++) {
+            responses.push_back(Response{millis() + behavior.delayMs, behavior.hold, name});
+        }
+        return true;
+    };
+
+    /**
+     * @brief Process handler: delivers the responses that are due, in the order they were sent
+     */
+    void process() {
+        for(auto it = responses.begin(); it != responses.end(); ) {
+            if (!Particle.connected()) {
+                // A response can't arrive while disconnected
+                it = responses.erase(it);
+            }
+            else if (!it->hold && millis() >= it->deliverMs) {
+                String data = it->data;
+                it = responses.erase(it);
+                Particle.receive("particle/device/name", data.c_str());
+            }
+            else {
+                it++;
+            }
+        }
+    };
+
+    /**
+     * @brief Delivers the held responses now, newest first
+     */
+    void releaseReversed() {
+        std::vector<String> held;
+        for(auto it = responses.begin(); it != responses.end(); ) {
+            if (it->hold) {
+                held.push_back(it->data);
+                it = responses.erase(it);
+            }
+            else {
+                it++;
+            }
+        }
+        for(auto it = held.rbegin(); it != held.rend(); it++) {
+            Particle.receive("particle/device/name", it->c_str());
+        }
+    };
+
+    struct Response {
+        unsigned long deliverMs;
+        bool hold;
+        String data;
+    };
+
+    Behavior defaultBehavior = {200, 1, false};
+    std::deque<Behavior> behaviors;
+    std::vector<Response> responses;
+    std::vector<unsigned long> publishTimes;
+};
+
+static MockCloud cloud;
+
+/**
+ * @brief Runs the helper and the mock cloud for ms milliseconds of simulated time
+ */
+static void run(TestHelper &helper, unsigned long ms) {
+    for(unsigned long ii = 0; ii < ms; ii += 10) {
+        Particle.process();
+        helper.loop();
+        Time.advance(10);
+    }
+}
+
+/**
+ * @brief Runs until the helper has a name, up to maxMs. Returns how long it took.
+ */
+static unsigned long runUntilName(TestHelper &helper, unsigned long maxMs) {
+    unsigned long start = millis();
+    while(!helper.hasName() && millis() - start < maxMs) {
+        run(helper, 10);
+    }
+    return millis() - start;
+}
+
+/**
+ * @brief Starts a test with a new helper and an empty mock cloud
+ */
+static TestHelper *startTest() {
+    cloud.reset();
+    Particle.unsubscribe();
+    Particle.setConnected(true);
+
+    TestHelper *helper = new TestHelper();
+    helper->withRandomSeed(1);
+    helper->setup();
+    return helper;
+}
+
+static void testRoundTrip() {
+    cloud.defaultBehavior = {300, 1, false};
+    TestHelper *helper = startTest();
+
+    // Registering a format twice is ignored, instead of linking it to itself
+    static DeviceNameHelperFormatBuffer<32> topic("fleet/%s");
+    helper->withNameFormat(topic).withNameFormat(topic);
+
+    unsigned long elapsed = runUntilName(*helper, 10000);
+    CHECK(helper->hasName());
+    CHECK(strcmp(helper->getName(), "name-1") == 0);
+    CHECK(strcmp(topic.c_str(), "fleet/name-1") == 0);
+
+    // The request is made after the 2 second subscription wait
+    CHECK(cloud.publishTimes.size() == 1);
+    CHECK(elapsed >= 2300 && elapsed <= 2350);
+
+    const DeviceNameHelperStats &stats = helper->getStats();
+    CHECK(stats.requestCount == 1);
+    CHECK(stats.responseCount == 1);
+    CHECK(stats.responseWaitMs >= 300 && stats.responseWaitMs <= 320);
+    CHECK(stats.dataOperations == 2);
+    CHECK(helper->isWaitingForRecheck());
+
+    delete helper;
+}
+
+static void testDelayedPastTimeout() {
+    cloud.defaultBehavior = {200, 1, false};
+    TestHelper *helper = startTest();
+    cloud.behaviors.push_back({20000, 1, false});
+
+    // Times out 15 seconds after the request
+    run(*helper, 2000 + TestHelper::RESPONSE_WAIT_MS + 100);
+    CHECK(helper->isWaitingForRetry());
+    CHECK(!helper->hasName());
+
+    // The late response is ignored
+    run(*helper, 10000);
+    CHECK(!helper->hasName());
+    CHECK(helper->getStats().ignoredResponseCount == 1);
+
+    // Retried after about 5 minutes, with jitter
+    runUntilName(*helper, 10 * 60 * 1000);
+    CHECK(strcmp(helper->getName(), "name-2") == 0);
+    CHECK(cloud.publishTimes.size() == 2);
+    unsigned long retryWait = cloud.publishTimes[1] - cloud.publishTimes[0] - TestHelper::RESPONSE_WAIT_MS;
+    CHECK(retryWait >= TestHelper::RETRY_WAIT_MS - TestHelper::RETRY_JITTER_MS / 2);
+    CHECK(retryWait <= TestHelper::RETRY_WAIT_MS + TestHelper::RETRY_JITTER_MS / 2 + 2100);
+
+    delete helper;
+}
+
+static void testDropped() {
+    cloud.defaultBehavior = {200, 1, false};
+    TestHelper *helper = startTest();
+    cloud.behaviors.push_back({0, 0, false});
+
+    run(*helper, 2000 + TestHelper::RESPONSE_WAIT_MS + 100);
+    CHECK(helper->isWaitingForRetry());
+    CHECK(helper->getStats().responseCount == 0);
+
+    runUntilName(*helper, 10 * 60 * 1000);
+    CHECK(strcmp(helper->getName(), "name-2") == 0);
+    CHECK(helper->getStats().requestCount == 2);
+
+    delete helper;
+}
+
+static void testPublishFails() {
+    TestHelper *helper = startTest();
+    MockCloud::Behavior failed = {0, 0, false};
+    failed.fail = true;
+    cloud.behaviors.push_back(failed);
+
+    // The failed publish goes straight to the retry wait instead of waiting for a response
+    run(*helper, 2100);
+    CHECK(helper->isWaitingForRetry());
+    const DeviceNameHelperStats &stats = helper->getStats();
+    CHECK(stats.sendFailedCount == 1);
+    CHECK(stats.requestCount == 0);
+    CHECK(stats.dataOperations == 0);
+
+    runUntilName(*helper, 10 * 60 * 1000);
+    CHECK(strcmp(helper->getName(), "name-2") == 0);
+    CHECK(stats.requestCount == 1);
+
+    delete helper;
+}
+
+static void testDuplicate() {
+    TestHelper *helper = startTest();
+    cloud.behaviors.push_back({200, 3, false});
+
+    runUntilName(*helper, 10000);
+    run(*helper, 1000);
+    CHECK(strcmp(helper->getName(), "name-1") == 0);
+
+    const DeviceNameHelperStats &stats = helper->getStats();
+    CHECK(stats.requestCount == 1);
+    CHECK(stats.responseCount == 3);
+    CHECK(stats.ignoredResponseCount == 2);
+
+    delete helper;
+}
+
+static void testReordered() {
+    TestHelper *helper = startTest();
+    cloud.behaviors.push_back({0, 1, true});
+    cloud.behaviors.push_back({0, 1, true});
+
+    // The first request times out and is retried
+    run(*helper, 2000 + TestHelper::RESPONSE_WAIT_MS + 100);
+    CHECK(helper->isWaitingForRetry());
+    for(int ii = 0; ii < 60000 && cloud.publishTimes.size() < 2; ii++) {
+        run(*helper, 10);
+    }
+    CHECK(cloud.publishTimes.size() == 2);
+    CHECK(helper->isWaitingForResponse());
+
+    // Both responses arrive, newest first. Only the first one is used.
+    cloud.releaseReversed();
+    run(*helper, 100);
+    CHECK(strcmp(helper->getName(), "name-2") == 0);
+    CHECK(helper->getStats().ignoredResponseCount == 1);
+
+    delete helper;
+}
+
+static void testDisconnect() {
+    TestHelper *helper = startTest();
+    cloud.behaviors.push_back({5000, 1, false});
+
+    // Disconnect while waiting for the response
+    run(*helper, 3000);
+    CHECK(helper->isWaitingForResponse());
+    Particle.setConnected(false);
+    run(*helper, 10000);
+    CHECK(helper->getStats().abortedRequestCount == 1);
+    CHECK(!helper->hasName());
+
+    // The request is made again after reconnecting, without waiting for the retry period
+    Particle.setConnected(true);
+    unsigned long elapsed = runUntilName(*helper, 10000);
+    CHECK(strcmp(helper->getName(), "name-2") == 0);
+    CHECK(elapsed < 3000);
+
+    delete helper;
+}
+
+int main() {
+    Time.withSimulatedClock();
+    Particle.withPublishHandler([](const char *eventName, const char *eventData) {
+            return cloud.publish(eventName, eventData);
+        })
+        .withProcessHandler([]() {
+            cloud.process();
+        });
+
+    testRoundTrip();
+    testDelayedPastTimeout();
+    testDropped();
+    testPublishFails();
+    testDuplicate();
+    testReordered();
+    testDisconnect();
+
+    return testResult("latency_test");
+}